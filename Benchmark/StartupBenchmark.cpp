@@ -0,0 +1,99 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "QGlitter/QGlitterUpdater.h"
+#include "QGlitter/Crypto/Crypto.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+#include <QSettings>
+
+#include <iomanip>
+#include <iostream>
+
+static const int kDefaultIterations = 200;
+
+static void printResult(const char *label, qint64 nanoseconds, int iterations)
+{
+	std::cout << std::left << std::setw(40) << label << std::right << std::setw(12) << std::fixed << std::setprecision(1)
+			  << (nanoseconds / 1000.0) / iterations << " us" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication application(argc, argv);
+
+	application.setApplicationName("QGlitterStartupBenchmark");
+	application.setOrganizationDomain("com.aegos.qglitter.benchmark");
+
+	int iterations = kDefaultIterations;
+	if (argc == 2) {
+		bool ok = false;
+		iterations = QString(argv[1]).toInt(&ok);
+		if (!ok || iterations < 1) {
+			std::cerr << "Usage: qglitter-startup-benchmark [iterations]" << std::endl;
+			return -1;
+		}
+	}
+
+	QElapsedTimer timer;
+
+	// Construction as the application sees it on launch
+	timer.start();
+	for (int i = 0; i < iterations; ++i) {
+		QGlitterUpdater updater;
+	}
+	qint64 construction = timer.nsecsElapsed();
+
+	// The settings read and timer setup that construction defers until the event loop is idle
+	qint64 deferred = 0;
+	for (int i = 0; i < iterations; ++i) {
+		QGlitterUpdater updater;
+
+		timer.restart();
+		application.processEvents();
+		deferred += timer.nsecsElapsed();
+	}
+
+	// What the constructor used to do eagerly, for comparison
+	timer.restart();
+	QGlitter::cryptoInit();
+	qint64 cryptoInit = timer.nsecsElapsed();
+
+	timer.restart();
+	for (int i = 0; i < iterations; ++i) {
+		QNetworkAccessManager updaterNetworkAccess;
+		QNetworkAccessManager downloaderNetworkAccess;
+		QSettings settings(QSettings::UserScope, "QGlitter", "com.aegos.qglitter.benchmark.QGlitterStartupBenchmark");
+		settings.value("QGlitter/AutomaticCheck");
+	}
+	qint64 eager = timer.nsecsElapsed();
+
+	std::cout << "Iterations: " << iterations << std::endl << std::endl;
+
+	printResult("QGlitterUpdater construction", construction, iterations);
+	printResult("Deferred scheduling (idle)", deferred, iterations);
+	std::cout << std::endl;
+	printResult("Formerly eager: cryptoInit (once)", cryptoInit, 1);
+	printResult("Formerly eager: 2 QNAM + QSettings", eager, iterations);
+
+	return 0;
+}
@@ -21,16 +21,113 @@
 #pragma once
 
 #include "QGlitter/QGlitterConfig.h"
+#include "QGlitter/QGlitterObject.h"
+
+#include <QByteArray>
+#include <QString>
 
-class QByteArray;
 class QIODevice;
-class QString;
+template <typename T> class QList;
+
+namespace QGlitter {
+
+enum SignatureAlgorithm
+{
+	UnknownSignatureAlgorithm = 0,
+
+	DsaSha1,
+	Ed25519Sha256,
+};
+
+// Outcome of a single digest, sign or verify call, signature is base64 encoded
+struct CryptoResult
+{
+	CryptoResult() : success(false) {}
+
+	bool success;
+	QString errorMessage;
+	QByteArray digest;
+	QByteArray signature;
+};
+
+}
+
+// Keys are parsed once and can be shared between threads, copies share the parsed key
+class QGlitterPublicKeyPrivate;
+class QGLITTER_EXPORTED QGlitterPublicKey : public QGlitterObject
+{
+public:
+	QGlitterPublicKey();
+	explicit QGlitterPublicKey(const QByteArray &pem);
+	QGlitterPublicKey(const QGlitterPublicKey &other);
+
+	QGlitterPublicKey &operator=(const QGlitterPublicKey &rhs);
+
+	QGlitter::SignatureAlgorithm algorithm() const;
+	Qt::HANDLE handle() const;
+	bool isNull() const;
+	bool isValid() const;
+
+private:
+	QGLITTER_DECLARE_PRIVATE(QGlitterPublicKey);
+};
+
+class QGlitterPrivateKeyPrivate;
+class QGLITTER_EXPORTED QGlitterPrivateKey : public QGlitterObject
+{
+public:
+	QGlitterPrivateKey();
+	QGlitterPrivateKey(const QByteArray &pem, const QString &passphrase);
+	QGlitterPrivateKey(const QGlitterPrivateKey &other);
+
+	QGlitterPrivateKey &operator=(const QGlitterPrivateKey &rhs);
+
+	QGlitter::SignatureAlgorithm algorithm() const;
+	Qt::HANDLE handle() const;
+	bool isNull() const;
+	bool isValid() const;
+
+private:
+	QGLITTER_DECLARE_PRIVATE(QGlitterPrivateKey);
+};
 
 namespace QGlitter {
 
+// All functions are reentrant. Key parsing, key generation and the legacy dsa*() functions report
+// their failures through errorMessage(), which holds the last error of the calling thread.
 QGLITTER_EXPORTED void cryptoInit();
 QGLITTER_EXPORTED const QString &errorMessage();
 
+QGLITTER_EXPORTED QString signatureAlgorithmName(SignatureAlgorithm algorithm);
+QGLITTER_EXPORTED SignatureAlgorithm signatureAlgorithmFromName(const QString &name);
+QGLITTER_EXPORTED SignatureAlgorithm keyAlgorithm(const QByteArray &publicKey);
+
+// generateKeyPair() hands back the PEM encoded keys, keygen() writes them to the working directory
+QGLITTER_EXPORTED bool generateKeyPair(SignatureAlgorithm algorithm, int size, const QString &passphrase, QByteArray *privateKey, QByteArray *publicKey);
+QGLITTER_EXPORTED bool keygen(SignatureAlgorithm algorithm, int size, const QString &passphrase);
+
+// Each call reports its outcome in the returned result. The digest and signature scheme follow
+// from the type of the key, digestDevice() computes the digest a key of the given algorithm signs.
+QGLITTER_EXPORTED CryptoResult digestDevice(QIODevice &sourceData, SignatureAlgorithm algorithm);
+QGLITTER_EXPORTED CryptoResult verifyDevice(QIODevice &sourceData, const QByteArray &signature, const QGlitterPublicKey &publicKey);
+QGLITTER_EXPORTED CryptoResult signDevice(QIODevice &sourceData, const QGlitterPrivateKey &privateKey);
+QGLITTER_EXPORTED CryptoResult verifyDigest(const QByteArray &digest, const QByteArray &signature, const QGlitterPublicKey &publicKey);
+QGLITTER_EXPORTED CryptoResult signDigest(const QByteArray &digest, const QGlitterPrivateKey &privateKey);
+
+// Tree mode signs the root of a SHA-256 Merkle tree over chunkSize sized chunks, bound to the
+// chunk size by treeSigningDigest(). A file opened by name at its start is hashed in parallel,
+// any other device in a single sequential pass.
+QGLITTER_EXPORTED CryptoResult treeDigest(QIODevice &sourceData, qint64 chunkSize);
+QGLITTER_EXPORTED CryptoResult verifyTree(QIODevice &sourceData, qint64 chunkSize, const QByteArray &signature, const QGlitterPublicKey &publicKey);
+QGLITTER_EXPORTED CryptoResult signTree(QIODevice &sourceData, qint64 chunkSize, const QGlitterPrivateKey &privateKey);
+
+// The pieces of the tree, for chunk manifests and checking chunks as they arrive
+QGLITTER_EXPORTED QList<QByteArray> treeLeafDigests(const QString &fileName, qint64 chunkSize);
+QGLITTER_EXPORTED QByteArray treeLeafDigest(const QByteArray &chunk);
+QGLITTER_EXPORTED QByteArray treeRootDigest(const QList<QByteArray> &leaves);
+QGLITTER_EXPORTED QByteArray treeSigningDigest(const QByteArray &rootDigest, qint64 chunkSize);
+
+// Kept for existing callers, these accept any supported key type despite their names
 QGLITTER_EXPORTED bool dsaKeygen(int size, const QString &passphrase);
 QGLITTER_EXPORTED bool dsaVerify(QIODevice &sourceData, const QByteArray &signature, const QByteArray &publicKey);
 QGLITTER_EXPORTED QByteArray dsaSign(QIODevice &sourceData, const QByteArray &privateKey, const QString &passphrase);
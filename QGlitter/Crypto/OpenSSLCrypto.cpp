@@ -20,8 +20,15 @@
 
 #include "Crypto/Crypto.h"
 
+#include <QFile>
 #include <QIODevice>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
 #include <QString>
+#include <QThread>
+#include <QThreadStorage>
+#include <QtConcurrentMap>
 
 #include <openssl/bio.h>
 #include <openssl/dsa.h>
@@ -29,20 +36,150 @@
 #include <openssl/evp.h>
 #include <openssl/pem.h>
 
-#include <cstdio>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #if defined WIN32 && !defined __MINGW32__
 #include <openssl/applink.c>
 #endif
 
-static QByteArray messageDigest(QIODevice &sourceData)
+// Ed25519 through the EVP interface arrived with OpenSSL 1.1.1
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define QGLITTER_HAVE_ED25519
+#endif
+
+static const char * const kDsaSha1Name = "dsa-sha1";
+static const char * const kEd25519Sha256Name = "ed25519-sha256";
+
+// errorMessage() reports the last failure of the calling thread
+Q_GLOBAL_STATIC(QThreadStorage<QString *>, s_errorMessages)
+
+static QString &threadErrorMessage()
+{
+	if (!s_errorMessages()->hasLocalData()) {
+		s_errorMessages()->setLocalData(new QString);
+	}
+
+	return *s_errorMessages()->localData();
+}
+
+// ERR_error_string() with a null buffer formats into a static one, which isn't thread safe
+static QString openSSLError()
+{
+	char buffer[256] = {};
+	ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+
+	return QString::fromLatin1(buffer);
+}
+
+static bool reportResult(const QGlitter::CryptoResult &result)
+{
+	if (!result.success) {
+		threadErrorMessage() = result.errorMessage;
+	}
+
+	return result.success;
+}
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+// OpenSSL before 1.1 is only thread safe when the application provides the locks
+static QMutex *s_openSSLLocks = 0;
+
+static void openSSLLockingCallback(int mode, int n, const char *, int)
+{
+	if (mode & CRYPTO_LOCK) {
+		s_openSSLLocks[n].lock();
+	} else {
+		s_openSSLLocks[n].unlock();
+	}
+}
+
+static unsigned long openSSLThreadId()
+{
+	return (unsigned long)(quintptr)QThread::currentThreadId();
+}
+#endif
+
+static const qint64 kMapStride = 64 * 1024 * 1024;
+static const int kReadBufferSize = 256 * 1024;
+
+// Hashes straight from a mapping of the file when it can be mapped, otherwise
+// reads through a single reused buffer
+static bool digestFileRange(EVP_MD_CTX *mdctx, QFile &file, qint64 offset, qint64 length)
+{
+	qint64 position = offset;
+	qint64 end = offset + length;
+
+	while (position < end) {
+		qint64 stride = qMin(kMapStride, end - position);
+		uchar *data = file.map(position, stride);
+		if (!data) {
+			break;
+		}
+
+#ifdef Q_OS_UNIX
+		// The mapping itself starts on the page boundary below data
+		quintptr pageSize = sysconf(_SC_PAGESIZE);
+		uchar *pageStart = data - ((quintptr)data % pageSize);
+		posix_madvise(pageStart, stride + (data - pageStart), POSIX_MADV_SEQUENTIAL);
+#endif
+
+		EVP_DigestUpdate(mdctx, data, stride);
+		file.unmap(data);
+
+		position += stride;
+	}
+
+	if (position == end) {
+		return true;
+	}
+
+	if (!file.seek(position)) {
+		return false;
+	}
+
+	QByteArray buffer(kReadBufferSize, 0);
+	while (position < end) {
+		qint64 bytesRead = file.read(buffer.data(), qMin<qint64>(buffer.size(), end - position));
+		if (bytesRead <= 0) {
+			return false;
+		}
+
+		EVP_DigestUpdate(mdctx, buffer.constData(), bytesRead);
+		position += bytesRead;
+	}
+
+	return true;
+}
+
+// Returns an empty digest when the data couldn't be read
+static QByteArray messageDigest(QIODevice &sourceData, const EVP_MD *md)
 {
 	EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
-	EVP_DigestInit_ex(mdctx, EVP_sha1(), NULL);
+	EVP_DigestInit_ex(mdctx, md, NULL);
+
+	bool success = true;
+
+	QFile *file = qobject_cast<QFile *>(&sourceData);
+	if (file && !file->isSequential()) {
+		qint64 position = file->pos();
+		success = digestFileRange(mdctx, *file, position, file->size() - position) && file->seek(file->size());
+	} else {
+		QByteArray buffer(kReadBufferSize, 0);
 
-	while (!sourceData.atEnd()) {
-		QByteArray buffer = sourceData.read(4096);
-		EVP_DigestUpdate(mdctx, buffer.constData(), buffer.size());
+		qint64 bytesRead = 0;
+		while ((bytesRead = sourceData.read(buffer.data(), buffer.size())) > 0) {
+			EVP_DigestUpdate(mdctx, buffer.constData(), bytesRead);
+		}
+
+		success = bytesRead == 0 || sourceData.atEnd();
+	}
+
+	if (!success) {
+		EVP_MD_CTX_destroy(mdctx);
+		return QByteArray();
 	}
 
 	unsigned int md_len = 0;
@@ -53,118 +190,829 @@ static QByteArray messageDigest(QIODevice &sourceData)
 	return QByteArray((const char *)md_value, md_len);
 }
 
-void QGlitter::cryptoInit()
+static const unsigned char kTreeLeafPrefix = 0x00;
+static const unsigned char kTreeNodePrefix = 0x01;
+static const char kTreeSignatureTag[] = "qglitter-tree-v1";
+
+static QByteArray treeNodeDigest(const QByteArray &left, const QByteArray &right)
 {
-	OpenSSL_add_all_ciphers();
-	ERR_load_crypto_strings();
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
+	EVP_DigestUpdate(mdctx, &kTreeNodePrefix, 1);
+	EVP_DigestUpdate(mdctx, left.constData(), left.size());
+	EVP_DigestUpdate(mdctx, right.constData(), right.size());
+
+	unsigned int md_len = 0;
+	unsigned char md_value[EVP_MAX_MD_SIZE] = {};
+	EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+	EVP_MD_CTX_destroy(mdctx);
+
+	return QByteArray((const char *)md_value, md_len);
 }
 
-static QString s_qglitterErrorMessage = "";
+// Every worker opens the file on its own so reads never contend on a shared position
+struct TreeLeafDigest
+{
+	typedef QByteArray result_type;
 
-const QString &QGlitter::errorMessage()
+	TreeLeafDigest(const QString &fileName, qint64 chunkSize)
+		: fileName(fileName)
+		, chunkSize(chunkSize)
+	{
+	}
+
+	QByteArray operator()(qint64 chunkIndex) const
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly)) {
+			return QByteArray();
+		}
+
+		qint64 offset = chunkIndex * chunkSize;
+		qint64 length = qBound<qint64>(0, file.size() - offset, chunkSize);
+
+		EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+		EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
+		EVP_DigestUpdate(mdctx, &kTreeLeafPrefix, 1);
+
+		if (!digestFileRange(mdctx, file, offset, length)) {
+			EVP_MD_CTX_destroy(mdctx);
+			return QByteArray();
+		}
+
+		unsigned int md_len = 0;
+		unsigned char md_value[EVP_MAX_MD_SIZE] = {};
+		EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+		EVP_MD_CTX_destroy(mdctx);
+
+		return QByteArray((const char *)md_value, md_len);
+	}
+
+	QString fileName;
+	qint64 chunkSize;
+};
+
+
+static QList<QByteArray> treeLeaves(const QString &fileName, qint64 chunkSize, QString *errorMessage)
 {
-	return s_qglitterErrorMessage;
+	QFile file(fileName);
+	if (chunkSize <= 0 || !file.exists()) {
+		*errorMessage = "Unable to hash " + fileName;
+		return QList<QByteArray>();
+	}
+
+	// An empty file still has a single, empty, leaf
+	QList<qint64> chunks;
+	qint64 chunkCount = qMax<qint64>(1, (file.size() + chunkSize - 1) / chunkSize);
+	for (qint64 i = 0; i < chunkCount; ++i) {
+		chunks.append(i);
+	}
+
+	QList<QByteArray> leaves = QtConcurrent::blockingMapped<QList<QByteArray> >(chunks, TreeLeafDigest(fileName, chunkSize));
+	foreach (const QByteArray &leaf, leaves) {
+		if (leaf.isEmpty()) {
+			*errorMessage = "Unable to hash " + fileName;
+			return QList<QByteArray>();
+		}
+	}
+
+	return leaves;
 }
 
-bool QGlitter::dsaKeygen(int size, const QString &passphrase)
+// Sequential counterpart of treeLeaves() for pipes, the data is read once from start to end
+static QList<QByteArray> streamTreeLeaves(QIODevice &sourceData, qint64 chunkSize, QString *errorMessage)
 {
-	bool success = false;
+	if (chunkSize <= 0) {
+		*errorMessage = "Invalid chunk size";
+		return QList<QByteArray>();
+	}
+
+	QList<QByteArray> leaves;
+
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
+	EVP_DigestUpdate(mdctx, &kTreeLeafPrefix, 1);
+
+	unsigned int md_len = 0;
+	unsigned char md_value[EVP_MAX_MD_SIZE] = {};
 
-	DSA *dsa = DSA_generate_parameters(size, NULL, 0, NULL, NULL, NULL, NULL);
-	if (dsa) {
-		if (DSA_generate_key(dsa)) {
-			const EVP_CIPHER *enc = NULL;
-			unsigned char *kstr = 0;
-			int klen = 0;
-
-			QByteArray passphraseData = passphrase.toUtf8();
-			if (passphraseData.size() > 0) {
-				enc = EVP_aes_256_cbc();
-				kstr = (unsigned char *)passphraseData.data();
-				klen = passphraseData.size();
+	QByteArray buffer(kReadBufferSize, 0);
+	qint64 chunkFill = 0;
+	qint64 bytesRead = 0;
+	while ((bytesRead = sourceData.read(buffer.data(), buffer.size())) > 0) {
+		qint64 offset = 0;
+		while (offset < bytesRead) {
+			qint64 length = qMin(bytesRead - offset, chunkSize - chunkFill);
+			EVP_DigestUpdate(mdctx, buffer.constData() + offset, length);
+			offset += length;
+			chunkFill += length;
+
+			if (chunkFill == chunkSize) {
+				EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+				leaves.append(QByteArray((const char *)md_value, md_len));
+
+				EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
+				EVP_DigestUpdate(mdctx, &kTreeLeafPrefix, 1);
+				chunkFill = 0;
 			}
+		}
+	}
+
+	if (bytesRead < 0 && !sourceData.atEnd()) {
+		EVP_MD_CTX_destroy(mdctx);
+		*errorMessage = "Unable to read the data to hash";
+		return QList<QByteArray>();
+	}
 
-			FILE *privateKeyFile = fopen("dsa_priv.pem", "w");
-			if (privateKeyFile && PEM_write_DSAPrivateKey(privateKeyFile, dsa, enc, kstr, klen, NULL, NULL)) {
-				FILE *publicKeyFile = fopen("dsa_pub.pem", "w");
-				if (publicKeyFile && PEM_write_DSA_PUBKEY(publicKeyFile, dsa)) {
-					success = true;
-				}
+	// A trailing partial chunk, or the single empty leaf of empty data
+	if (chunkFill > 0 || leaves.isEmpty()) {
+		EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+		leaves.append(QByteArray((const char *)md_value, md_len));
+	}
+
+	EVP_MD_CTX_destroy(mdctx);
+
+	return leaves;
+}
+
+// A file opened by name is hashed chunk by chunk in parallel, anything else in one sequential pass
+static QList<QByteArray> deviceTreeLeaves(QIODevice &sourceData, qint64 chunkSize, QString *errorMessage)
+{
+	QFile *file = qobject_cast<QFile *>(&sourceData);
+	if (!file || file->isSequential() || file->fileName().isEmpty() || file->pos() != 0) {
+		return streamTreeLeaves(sourceData, chunkSize, errorMessage);
+	}
+
+	QList<QByteArray> leaves = treeLeaves(file->fileName(), chunkSize, errorMessage);
+	file->seek(file->size());
+
+	return leaves;
+}
+
+static QGlitter::SignatureAlgorithm algorithmForKey(EVP_PKEY *key)
+{
+	switch (EVP_PKEY_id(key)) {
+	case EVP_PKEY_DSA:
+		return QGlitter::DsaSha1;
 
-				if (publicKeyFile) {
-					fclose(publicKeyFile);
-				}
+#ifdef QGLITTER_HAVE_ED25519
+	case EVP_PKEY_ED25519:
+		return QGlitter::Ed25519Sha256;
+#endif
+
+	default:
+		return QGlitter::UnknownSignatureAlgorithm;
+	}
+}
+
+static const EVP_MD *digestForAlgorithm(QGlitter::SignatureAlgorithm algorithm)
+{
+	switch (algorithm) {
+	case QGlitter::DsaSha1:
+		return EVP_sha1();
+
+	case QGlitter::Ed25519Sha256:
+		return EVP_sha256();
+
+	default:
+		return 0;
+	}
+}
+
+static EVP_PKEY *readPublicKey(const QByteArray &publicKey)
+{
+	BIO *publicKeyData = BIO_new_mem_buf((void *)publicKey.constData(), publicKey.size());
+	EVP_PKEY *key = PEM_read_bio_PUBKEY(publicKeyData, 0, 0, 0);
+	BIO_free(publicKeyData);
+
+	return key;
+}
+
+static EVP_PKEY *readPrivateKey(const QByteArray &privateKey, const QString &passphrase)
+{
+	QByteArray passphraseData = passphrase.toUtf8();
+
+	BIO *privateKeyData = BIO_new_mem_buf((void *)privateKey.constData(), privateKey.size());
+	EVP_PKEY *key = PEM_read_bio_PrivateKey(privateKeyData, 0, 0, (void *)passphraseData.constData());
+	BIO_free(privateKeyData);
+
+	return key;
+}
+
+// DSA signs the digest directly, Ed25519 treats it as the message
+static bool verifyDigestWithKey(EVP_PKEY *key, const QByteArray &digest, const QByteArray &rawSignature, QString *errorMessage)
+{
+	int status = -1;
+
+	if (EVP_PKEY_id(key) == EVP_PKEY_DSA) {
+		EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(key, 0);
+		if (ctx && EVP_PKEY_verify_init(ctx) > 0) {
+			status = EVP_PKEY_verify(ctx, (const unsigned char *)rawSignature.constData(), rawSignature.size(), (const unsigned char *)digest.constData(), digest.size());
+		}
+		EVP_PKEY_CTX_free(ctx);
+	} else if (algorithmForKey(key) == QGlitter::Ed25519Sha256) {
+#ifdef QGLITTER_HAVE_ED25519
+		EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+		if (EVP_DigestVerifyInit(mdctx, 0, 0, 0, key) > 0) {
+			status = EVP_DigestVerify(mdctx, (const unsigned char *)rawSignature.constData(), rawSignature.size(), (const unsigned char *)digest.constData(), digest.size());
+		}
+		EVP_MD_CTX_destroy(mdctx);
+#endif
+	}
+
+	if (status < 0) {
+		*errorMessage = openSSLError();
+	} else if (status == 0) {
+		*errorMessage = "Signature does not match";
+	}
+
+	return status > 0;
+}
+
+static QByteArray signDigestWithKey(EVP_PKEY *key, const QByteArray &digest, QString *errorMessage)
+{
+	QByteArray signature;
+	size_t signatureLength = 0;
+
+	if (EVP_PKEY_id(key) == EVP_PKEY_DSA) {
+		EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(key, 0);
+		if (ctx && EVP_PKEY_sign_init(ctx) > 0 && EVP_PKEY_sign(ctx, 0, &signatureLength, (const unsigned char *)digest.constData(), digest.size()) > 0) {
+			signature.resize(signatureLength);
+			if (EVP_PKEY_sign(ctx, (unsigned char *)signature.data(), &signatureLength, (const unsigned char *)digest.constData(), digest.size()) > 0) {
+				signature.truncate(signatureLength);
+			} else {
+				signature.clear();
 			}
+		}
+		EVP_PKEY_CTX_free(ctx);
+	} else if (algorithmForKey(key) == QGlitter::Ed25519Sha256) {
+#ifdef QGLITTER_HAVE_ED25519
+		EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+		if (EVP_DigestSignInit(mdctx, 0, 0, 0, key) > 0 && EVP_DigestSign(mdctx, 0, &signatureLength, (const unsigned char *)digest.constData(), digest.size()) > 0) {
+			signature.resize(signatureLength);
+			if (EVP_DigestSign(mdctx, (unsigned char *)signature.data(), &signatureLength, (const unsigned char *)digest.constData(), digest.size()) > 0) {
+				signature.truncate(signatureLength);
+			} else {
+				signature.clear();
+			}
+		}
+		EVP_MD_CTX_destroy(mdctx);
+#endif
+	}
+
+	if (signature.isEmpty()) {
+		*errorMessage = openSSLError();
+	}
 
-			if (privateKeyFile) {
-				fclose(privateKeyFile);
+	return signature;
+}
+
+static EVP_PKEY *generateKey(QGlitter::SignatureAlgorithm algorithm, int size)
+{
+	EVP_PKEY *key = 0;
+
+	if (algorithm == QGlitter::DsaSha1) {
+		DSA *dsa = DSA_generate_parameters(size, NULL, 0, NULL, NULL, NULL, NULL);
+		if (dsa && DSA_generate_key(dsa)) {
+			key = EVP_PKEY_new();
+			if (key && !EVP_PKEY_assign_DSA(key, dsa)) {
+				EVP_PKEY_free(key);
+				key = 0;
 			}
-		} else {
-			s_qglitterErrorMessage = ERR_error_string(ERR_get_error(), 0);
 		}
 
-		DSA_free(dsa);
+		if (!key && dsa) {
+			DSA_free(dsa);
+		}
+	}
+
+#ifdef QGLITTER_HAVE_ED25519
+	if (algorithm == QGlitter::Ed25519Sha256) {
+		EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, 0);
+		if (ctx && (EVP_PKEY_keygen_init(ctx) <= 0 || EVP_PKEY_keygen(ctx, &key) <= 0)) {
+			key = 0;
+		}
+		EVP_PKEY_CTX_free(ctx);
+	}
+#endif
+
+	return key;
+}
+
+static QString keyError(const QGlitterPublicKey &publicKey)
+{
+	if (publicKey.algorithm() != QGlitter::UnknownSignatureAlgorithm) {
+		return QString();
+	}
+
+	return publicKey.isValid() ? "Unsupported public key type" : "Invalid public key";
+}
+
+static QString keyError(const QGlitterPrivateKey &privateKey)
+{
+	if (privateKey.algorithm() != QGlitter::UnknownSignatureAlgorithm) {
+		return QString();
+	}
+
+	return privateKey.isValid() ? "Unsupported private key type" : "Invalid private key";
+}
+
+static bool writeKeyFile(const QString &fileName, const QByteArray &key)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(key) != key.size() || !file.flush()) {
+		threadErrorMessage() = "Unable to write " + fileName;
+		return false;
+	}
+
+	return true;
+}
+
+static QByteArray readMemoryBio(BIO *bio)
+{
+	char *data = 0;
+	long length = BIO_get_mem_data(bio, &data);
+
+	return QByteArray(data, (int)length);
+}
+
+class QGlitterPublicKeyPrivate : public QGlitterObjectData
+{
+	QGLITTER_DECLARE_PUBLIC(QGlitterPublicKey);
+public:
+	QGlitterPublicKeyPrivate()
+		: key()
+		, isNull(true)
+	{
+	}
+
+	QSharedPointer<EVP_PKEY> key;
+	bool isNull;
+};
+
+class QGlitterPrivateKeyPrivate : public QGlitterObjectData
+{
+	QGLITTER_DECLARE_PUBLIC(QGlitterPrivateKey);
+public:
+	QGlitterPrivateKeyPrivate()
+		: key()
+		, isNull(true)
+	{
+	}
+
+	QSharedPointer<EVP_PKEY> key;
+	bool isNull;
+};
+
+QGlitterPublicKey::QGlitterPublicKey()
+	: QGlitterObject(new QGlitterPublicKeyPrivate)
+{
+}
+
+QGlitterPublicKey::QGlitterPublicKey(const QByteArray &pem)
+	: QGlitterObject(new QGlitterPublicKeyPrivate)
+{
+	QGLITTER_D(QGlitterPublicKey);
+
+	QGlitter::cryptoInit();
+
+	d->isNull = pem.isEmpty();
+	if (d->isNull) {
+		return;
+	}
+
+	EVP_PKEY *key = readPublicKey(pem);
+	if (key) {
+		d->key = QSharedPointer<EVP_PKEY>(key, EVP_PKEY_free);
 	} else {
-		s_qglitterErrorMessage = ERR_error_string(ERR_get_error(), 0);
+		threadErrorMessage() = openSSLError();
 	}
+}
 
-	return success;
+QGlitterPublicKey::QGlitterPublicKey(const QGlitterPublicKey &other)
+	: QGlitterObject(new QGlitterPublicKeyPrivate)
+{
+	*this = other;
 }
 
-bool QGlitter::dsaVerify(QIODevice &sourceData, const QByteArray &signature, const QByteArray &publicKey)
+QGlitterPublicKey &QGlitterPublicKey::operator=(const QGlitterPublicKey &rhs)
 {
-	QByteArray rawSignature = QByteArray::fromBase64(signature);
-	BIO *publicKeyData = BIO_new_mem_buf((void *)publicKey.constData(), publicKey.size());
+	QGLITTER_D(QGlitterPublicKey);
+	d->key = rhs.qglitter_d_func()->key;
+	d->isNull = rhs.qglitter_d_func()->isNull;
 
-	bool verified = false;
+	return *this;
+}
 
-	DSA *dsa = PEM_read_bio_DSA_PUBKEY(publicKeyData, 0, 0, 0);
-	if (dsa) {
-		QByteArray digest = messageDigest(sourceData);
+QGlitter::SignatureAlgorithm QGlitterPublicKey::algorithm() const
+{
+	const QGLITTER_D(QGlitterPublicKey);
+	return !d->key.isNull() ? algorithmForKey(d->key.data()) : QGlitter::UnknownSignatureAlgorithm;
+}
 
-		int status = DSA_verify(0, (const unsigned char *)digest.constData(), digest.size(), (const unsigned char *)rawSignature.constData(), rawSignature.size(), dsa);
-		if (status > 0) {
-			verified = true;
-		} else if (status < 0) {
-			s_qglitterErrorMessage = ERR_error_string(ERR_get_error(), 0);
-		}
+Qt::HANDLE QGlitterPublicKey::handle() const
+{
+	const QGLITTER_D(QGlitterPublicKey);
+	return d->key.data();
+}
+
+bool QGlitterPublicKey::isNull() const
+{
+	const QGLITTER_D(QGlitterPublicKey);
+	return d->isNull;
+}
+
+bool QGlitterPublicKey::isValid() const
+{
+	const QGLITTER_D(QGlitterPublicKey);
+	return !d->key.isNull();
+}
+
+QGlitterPrivateKey::QGlitterPrivateKey()
+	: QGlitterObject(new QGlitterPrivateKeyPrivate)
+{
+}
+
+QGlitterPrivateKey::QGlitterPrivateKey(const QByteArray &pem, const QString &passphrase)
+	: QGlitterObject(new QGlitterPrivateKeyPrivate)
+{
+	QGLITTER_D(QGlitterPrivateKey);
 
-		DSA_free(dsa);
+	QGlitter::cryptoInit();
+
+	d->isNull = pem.isEmpty();
+	if (d->isNull) {
+		return;
+	}
+
+	EVP_PKEY *key = readPrivateKey(pem, passphrase);
+	if (key) {
+		d->key = QSharedPointer<EVP_PKEY>(key, EVP_PKEY_free);
 	} else {
-		s_qglitterErrorMessage = ERR_error_string(ERR_get_error(), 0);
+		threadErrorMessage() = openSSLError();
 	}
+}
 
-	BIO_free(publicKeyData);
+QGlitterPrivateKey::QGlitterPrivateKey(const QGlitterPrivateKey &other)
+	: QGlitterObject(new QGlitterPrivateKeyPrivate)
+{
+	*this = other;
+}
 
-	return verified;
+QGlitterPrivateKey &QGlitterPrivateKey::operator=(const QGlitterPrivateKey &rhs)
+{
+	QGLITTER_D(QGlitterPrivateKey);
+	d->key = rhs.qglitter_d_func()->key;
+	d->isNull = rhs.qglitter_d_func()->isNull;
+
+	return *this;
 }
 
-QByteArray QGlitter::dsaSign(QIODevice &sourceData, const QByteArray &privateKey, const QString &passphrase)
+QGlitter::SignatureAlgorithm QGlitterPrivateKey::algorithm() const
 {
-	BIO *privateKeyData = BIO_new_mem_buf((void *)privateKey.constData(), privateKey.size());
+	const QGLITTER_D(QGlitterPrivateKey);
+	return !d->key.isNull() ? algorithmForKey(d->key.data()) : QGlitter::UnknownSignatureAlgorithm;
+}
+
+Qt::HANDLE QGlitterPrivateKey::handle() const
+{
+	const QGLITTER_D(QGlitterPrivateKey);
+	return d->key.data();
+}
+
+bool QGlitterPrivateKey::isNull() const
+{
+	const QGLITTER_D(QGlitterPrivateKey);
+	return d->isNull;
+}
+
+bool QGlitterPrivateKey::isValid() const
+{
+	const QGLITTER_D(QGlitterPrivateKey);
+	return !d->key.isNull();
+}
+
+Q_GLOBAL_STATIC(QMutex, s_cryptoInitMutex)
+
+void QGlitter::cryptoInit()
+{
+	QMutexLocker locker(s_cryptoInitMutex());
+
+	static bool initialized = false;
+	if (initialized) {
+		return;
+	}
+
+	OpenSSL_add_all_ciphers();
+	ERR_load_crypto_strings();
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	s_openSSLLocks = new QMutex[CRYPTO_num_locks()];
+	CRYPTO_set_id_callback(openSSLThreadId);
+	CRYPTO_set_locking_callback(openSSLLockingCallback);
+#endif
+
+	initialized = true;
+}
+
+const QString &QGlitter::errorMessage()
+{
+	return threadErrorMessage();
+}
+
+QString QGlitter::signatureAlgorithmName(SignatureAlgorithm algorithm)
+{
+	switch (algorithm) {
+	case DsaSha1:
+		return kDsaSha1Name;
+
+	case Ed25519Sha256:
+		return kEd25519Sha256Name;
+
+	default:
+		return "";
+	}
+}
+
+QGlitter::SignatureAlgorithm QGlitter::signatureAlgorithmFromName(const QString &name)
+{
+	if (name.compare(kDsaSha1Name, Qt::CaseInsensitive) == 0 || name.compare("dsa", Qt::CaseInsensitive) == 0) {
+		return DsaSha1;
+	}
+
+	if (name.compare(kEd25519Sha256Name, Qt::CaseInsensitive) == 0 || name.compare("ed25519", Qt::CaseInsensitive) == 0) {
+		return Ed25519Sha256;
+	}
+
+	return UnknownSignatureAlgorithm;
+}
+
+QGlitter::SignatureAlgorithm QGlitter::keyAlgorithm(const QByteArray &publicKey)
+{
+	return QGlitterPublicKey(publicKey).algorithm();
+}
+
+bool QGlitter::generateKeyPair(SignatureAlgorithm algorithm, int size, const QString &passphrase, QByteArray *privateKey, QByteArray *publicKey)
+{
+	cryptoInit();
+
+	bool isSupported = algorithm == DsaSha1;
+#ifdef QGLITTER_HAVE_ED25519
+	isSupported = isSupported || algorithm == Ed25519Sha256;
+#endif
+
+	if (!isSupported) {
+		threadErrorMessage() = "Unsupported signature algorithm";
+		return false;
+	}
+
+	EVP_PKEY *key = generateKey(algorithm, size);
+	if (!key) {
+		threadErrorMessage() = openSSLError();
+		return false;
+	}
+
+	const EVP_CIPHER *enc = NULL;
+	unsigned char *kstr = 0;
+	int klen = 0;
 
 	QByteArray passphraseData = passphrase.toUtf8();
-	QByteArray signature;
+	if (passphraseData.size() > 0) {
+		enc = EVP_aes_256_cbc();
+		kstr = (unsigned char *)passphraseData.data();
+		klen = passphraseData.size();
+	}
+
+	bool success = false;
+
+	BIO *privateKeyBio = BIO_new(BIO_s_mem());
+	BIO *publicKeyBio = BIO_new(BIO_s_mem());
+	if (privateKeyBio && publicKeyBio && PEM_write_bio_PrivateKey(privateKeyBio, key, enc, kstr, klen, NULL, NULL) && PEM_write_bio_PUBKEY(publicKeyBio, key)) {
+		*privateKey = readMemoryBio(privateKeyBio);
+		*publicKey = readMemoryBio(publicKeyBio);
+		success = true;
+	} else {
+		threadErrorMessage() = openSSLError();
+	}
 
-	DSA *dsa = PEM_read_bio_DSAPrivateKey(privateKeyData, 0, 0, (void *)passphraseData.constData());
-	if (dsa) {
-		QByteArray digest = messageDigest(sourceData);
-		QByteArray dsaSignature(DSA_size(dsa), 0);
+	BIO_free(privateKeyBio);
+	BIO_free(publicKeyBio);
+	EVP_PKEY_free(key);
+
+	return success;
+}
+
+bool QGlitter::keygen(SignatureAlgorithm algorithm, int size, const QString &passphrase)
+{
+	QByteArray privateKey;
+	QByteArray publicKey;
+	if (!generateKeyPair(algorithm, size, passphrase, &privateKey, &publicKey)) {
+		return false;
+	}
 
-		unsigned int signatureLength = dsaSignature.size();
-		if (DSA_sign(0, (const unsigned char *)digest.constData(), digest.size(), (unsigned char *)dsaSignature.data(), &signatureLength, dsa)) {
-			dsaSignature.truncate(signatureLength);
-			signature = dsaSignature.toBase64();
-		} else {
-			s_qglitterErrorMessage = ERR_error_string(ERR_get_error(), 0);
+	QString prefix = algorithm == DsaSha1 ? "dsa" : "ed25519";
+	return writeKeyFile(prefix + "_priv.pem", privateKey) && writeKeyFile(prefix + "_pub.pem", publicKey);
+}
+
+QGlitter::CryptoResult QGlitter::digestDevice(QIODevice &sourceData, SignatureAlgorithm algorithm)
+{
+	cryptoInit();
+
+	CryptoResult result;
+
+	const EVP_MD *md = digestForAlgorithm(algorithm);
+	if (!md) {
+		result.errorMessage = "Unsupported signature algorithm";
+		return result;
+	}
+
+	result.digest = messageDigest(sourceData, md);
+	result.success = !result.digest.isEmpty();
+	if (!result.success) {
+		result.errorMessage = "Unable to read the data to hash";
+	}
+
+	return result;
+}
+
+QGlitter::CryptoResult QGlitter::verifyDevice(QIODevice &sourceData, const QByteArray &signature, const QGlitterPublicKey &publicKey)
+{
+	CryptoResult result;
+	result.errorMessage = keyError(publicKey);
+	if (result.errorMessage.isEmpty()) {
+		result = digestDevice(sourceData, publicKey.algorithm());
+	}
+
+	return result.success ? verifyDigest(result.digest, signature, publicKey) : result;
+}
+
+QGlitter::CryptoResult QGlitter::signDevice(QIODevice &sourceData, const QGlitterPrivateKey &privateKey)
+{
+	CryptoResult result;
+	result.errorMessage = keyError(privateKey);
+	if (result.errorMessage.isEmpty()) {
+		result = digestDevice(sourceData, privateKey.algorithm());
+	}
+
+	return result.success ? signDigest(result.digest, privateKey) : result;
+}
+
+QGlitter::CryptoResult QGlitter::verifyDigest(const QByteArray &digest, const QByteArray &signature, const QGlitterPublicKey &publicKey)
+{
+	cryptoInit();
+
+	CryptoResult result;
+	result.digest = digest;
+	result.signature = signature;
+
+	result.errorMessage = keyError(publicKey);
+	if (result.errorMessage.isEmpty()) {
+		result.success = verifyDigestWithKey((EVP_PKEY *)publicKey.handle(), digest, QByteArray::fromBase64(signature), &result.errorMessage);
+	}
+
+	return result;
+}
+
+QGlitter::CryptoResult QGlitter::signDigest(const QByteArray &digest, const QGlitterPrivateKey &privateKey)
+{
+	cryptoInit();
+
+	CryptoResult result;
+	result.digest = digest;
+
+	result.errorMessage = keyError(privateKey);
+	if (result.errorMessage.isEmpty()) {
+		result.signature = signDigestWithKey((EVP_PKEY *)privateKey.handle(), digest, &result.errorMessage).toBase64();
+		result.success = !result.signature.isEmpty();
+	}
+
+	return result;
+}
+
+QGlitter::CryptoResult QGlitter::treeDigest(QIODevice &sourceData, qint64 chunkSize)
+{
+	cryptoInit();
+
+	CryptoResult result;
+	result.digest = treeSigningDigest(treeRootDigest(deviceTreeLeaves(sourceData, chunkSize, &result.errorMessage)), chunkSize);
+	result.success = !result.digest.isEmpty();
+
+	return result;
+}
+
+QGlitter::CryptoResult QGlitter::verifyTree(QIODevice &sourceData, qint64 chunkSize, const QByteArray &signature, const QGlitterPublicKey &publicKey)
+{
+	CryptoResult result;
+	result.errorMessage = keyError(publicKey);
+	if (result.errorMessage.isEmpty()) {
+		result = treeDigest(sourceData, chunkSize);
+	}
+
+	return result.success ? verifyDigest(result.digest, signature, publicKey) : result;
+}
+
+QGlitter::CryptoResult QGlitter::signTree(QIODevice &sourceData, qint64 chunkSize, const QGlitterPrivateKey &privateKey)
+{
+	CryptoResult result;
+	result.errorMessage = keyError(privateKey);
+	if (result.errorMessage.isEmpty()) {
+		result = treeDigest(sourceData, chunkSize);
+	}
+
+	return result.success ? signDigest(result.digest, privateKey) : result;
+}
+
+QList<QByteArray> QGlitter::treeLeafDigests(const QString &fileName, qint64 chunkSize)
+{
+	QString errorMessage;
+	QList<QByteArray> leaves = treeLeaves(fileName, chunkSize, &errorMessage);
+	if (leaves.isEmpty()) {
+		threadErrorMessage() = errorMessage;
+	}
+
+	return leaves;
+}
+
+QByteArray QGlitter::treeLeafDigest(const QByteArray &chunk)
+{
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
+	EVP_DigestUpdate(mdctx, &kTreeLeafPrefix, 1);
+	EVP_DigestUpdate(mdctx, chunk.constData(), chunk.size());
+
+	unsigned int md_len = 0;
+	unsigned char md_value[EVP_MAX_MD_SIZE] = {};
+	EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+	EVP_MD_CTX_destroy(mdctx);
+
+	return QByteArray((const char *)md_value, md_len);
+}
+
+// An odd node at the end of a level is promoted to the next level unchanged
+QByteArray QGlitter::treeRootDigest(const QList<QByteArray> &leaves)
+{
+	if (leaves.isEmpty()) {
+		return QByteArray();
+	}
+
+	QList<QByteArray> level = leaves;
+	while (level.size() > 1) {
+		QList<QByteArray> nextLevel;
+		for (int i = 0; i + 1 < level.size(); i += 2) {
+			nextLevel.append(treeNodeDigest(level.at(i), level.at(i + 1)));
 		}
 
-		DSA_free(dsa);
-	} else {
-		s_qglitterErrorMessage = ERR_error_string(ERR_get_error(), 0);
+		if (level.size() % 2) {
+			nextLevel.append(level.last());
+		}
+
+		level = nextLevel;
 	}
 
-	BIO_free(privateKeyData);
+	return level.first();
+}
 
-	return signature;
+// A bare root is the SHA-256 of some short file as far as flat mode can tell, so what gets signed
+// is the root tagged with the mode and chunk size. A tree signature then never verifies a flat file.
+QByteArray QGlitter::treeSigningDigest(const QByteArray &rootDigest, qint64 chunkSize)
+{
+	if (rootDigest.isEmpty()) {
+		return QByteArray();
+	}
+
+	unsigned char encodedChunkSize[8];
+	for (int i = 0; i < 8; ++i) {
+		encodedChunkSize[i] = (unsigned char)(quint64(chunkSize) >> (56 - i * 8));
+	}
+
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+	EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL);
+	EVP_DigestUpdate(mdctx, kTreeSignatureTag, sizeof(kTreeSignatureTag) - 1);
+	EVP_DigestUpdate(mdctx, encodedChunkSize, sizeof(encodedChunkSize));
+	EVP_DigestUpdate(mdctx, rootDigest.constData(), rootDigest.size());
+
+	unsigned int md_len = 0;
+	unsigned char md_value[EVP_MAX_MD_SIZE] = {};
+	EVP_DigestFinal_ex(mdctx, md_value, &md_len);
+	EVP_MD_CTX_destroy(mdctx);
+
+	return QByteArray((const char *)md_value, md_len);
+}
+
+bool QGlitter::dsaKeygen(int size, const QString &passphrase)
+{
+	return keygen(DsaSha1, size, passphrase);
+}
+
+bool QGlitter::dsaVerify(QIODevice &sourceData, const QByteArray &signature, const QByteArray &publicKey)
+{
+	return reportResult(verifyDevice(sourceData, signature, QGlitterPublicKey(publicKey)));
+}
+
+QByteArray QGlitter::dsaSign(QIODevice &sourceData, const QByteArray &privateKey, const QString &passphrase)
+{
+	CryptoResult result = signDevice(sourceData, QGlitterPrivateKey(privateKey, passphrase));
+	reportResult(result);
+
+	return result.signature;
 }
@@ -20,9 +20,85 @@
 
 #include "QGlitterAppcast.h"
 #include "QGlitterAppcast_p.h"
+#include "Crypto/Crypto.h"
+
+#include <QDateTime>
+#include <QLocale>
+#include <QMap>
+#include <QStringList>
 
 static const char * const kSparkleNamespace = "http://www.andymatuschak.org/xml-namespaces/sparkle";
 
+// RSS dates are RFC 822, e.g. "Mon, 01 Jan 2024 12:00:00 +0000", which QDateTime doesn't parse on its own
+static QDateTime parseRfc822Date(QString value)
+{
+	value = value.simplified();
+
+	int comma = value.indexOf(',');
+	if (comma >= 0) {
+		value = value.mid(comma + 1).trimmed();
+	}
+
+	QStringList parts = value.split(' ');
+	if (parts.size() < 4) {
+		return QDateTime();
+	}
+
+	QString time = parts.at(3);
+	if (time.count(':') == 1) {
+		time += ":00";
+	}
+
+	QDateTime date = QLocale::c().toDateTime(QString("%1 %2 %3 %4").arg(parts.at(0), parts.at(1), parts.at(2), time), "d MMM yyyy hh:mm:ss");
+	if (!date.isValid()) {
+		return QDateTime();
+	}
+
+	date.setTimeSpec(Qt::UTC);
+
+	// Numeric offsets and the zone names RFC 822 allows, anything else is taken as UTC
+	int offset = 0;
+	QString zone = parts.size() > 4 ? parts.at(4).toUpper() : QString("GMT");
+	if ((zone.startsWith('+') || zone.startsWith('-')) && zone.size() == 5) {
+		offset = (zone.mid(1, 2).toInt() * 60 + zone.mid(3, 2).toInt()) * 60;
+		if (zone.startsWith('-')) {
+			offset = -offset;
+		}
+	} else if (zone == "EDT") {
+		offset = -4 * 3600;
+	} else if (zone == "EST" || zone == "CDT") {
+		offset = -5 * 3600;
+	} else if (zone == "CST" || zone == "MDT") {
+		offset = -6 * 3600;
+	} else if (zone == "MST" || zone == "PDT") {
+		offset = -7 * 3600;
+	} else if (zone == "PST") {
+		offset = -8 * 3600;
+	}
+
+	return date.addSecs(-offset);
+}
+
+// "0:5, 24:25, 72:100" offers the item to 5% at publication, 25% after a day and everyone after three
+static QMap<int, int> parsePhasedRollout(const QString &value)
+{
+	QMap<int, int> schedule;
+
+	foreach (const QString &stage, value.split(',', QString::SkipEmptyParts)) {
+		QStringList parts = stage.trimmed().split(':');
+
+		bool hoursOk = false;
+		bool percentageOk = false;
+		int hours = parts.size() == 2 ? parts.at(0).trimmed().toInt(&hoursOk) : 0;
+		int percentage = parts.size() == 2 ? parts.at(1).trimmed().remove('%').toInt(&percentageOk) : 0;
+		if (hoursOk && percentageOk && hours >= 0) {
+			schedule.insert(hours, percentage);
+		}
+	}
+
+	return schedule;
+}
+
 QGlitterAppcast::QGlitterAppcast()
 	: QGlitterObject(new QGlitterAppcastPrivate)
 {
@@ -100,7 +176,9 @@ void QGlitterAppcast::readItem()
 		if (d->xmlReader.name() == "title") {
 			currentItem.setTitle(d->xmlReader.readElementText());
 		} else if (d->xmlReader.name() == "pubDate") {
-			currentItem.setPublicationDate(QDateTime::fromString(d->xmlReader.readElementText()));
+			currentItem.setPublicationDate(parseRfc822Date(d->xmlReader.readElementText()));
+		} else if (d->xmlReader.name() == "phasedRollout" && d->xmlReader.namespaceUri() == kSparkleNamespace) {
+			currentItem.setPhasedRollout(parsePhasedRollout(d->xmlReader.readElementText()));
 		} else if (d->xmlReader.name() == "releaseNotesLink" && d->xmlReader.namespaceUri() == kSparkleNamespace) {
 			QString language = d->xmlReader.attributes().value("xml:lang").toString();
 			if (language.size() == 0) {
@@ -134,10 +212,13 @@ void QGlitterAppcast::readItem()
 				currentItem.setSize(attributes.value("length").toString().toInt());
 				currentItem.setUrl(attributes.value("url").toString());
 
+				currentItem.setChunkManifestUrl(attributes.value(kSparkleNamespace, "chunkManifest").toString());
 				currentItem.setDeltaFrom(attributes.value(kSparkleNamespace, "deltaFrom").toString());
 				currentItem.setOperatingSystem(attributes.value(kSparkleNamespace, "os").toString());
 				currentItem.setShortVersionString(attributes.value(kSparkleNamespace, "shortVersionString").toString());
 				currentItem.setSignature(attributes.value(kSparkleNamespace, "dsaSignature").toString());
+				currentItem.addSignature(QGlitter::signatureAlgorithmName(QGlitter::Ed25519Sha256), attributes.value(kSparkleNamespace, "ed25519Signature").toString());
+				currentItem.setTreeChunkSize(attributes.value(kSparkleNamespace, "treeChunkSize").toString().toInt());
 				currentItem.setVersion(attributes.value(kSparkleNamespace, "version").toString());
 			} else {
 				d->xmlReader.raiseError(tr("Invalid RSS enclosure"));
@@ -20,18 +20,22 @@
 
 #include "QGlitterAppcastItem.h"
 #include "QGlitterAppcastItem_p.h"
+#include "Crypto/Crypto.h"
 
 QGlitterAppcastItemPrivate::QGlitterAppcastItemPrivate()
-	: deltaFrom("")
+	: chunkManifestUrl("")
+	, deltaFrom("")
 	, descriptions()
 	, mimeType("")
 	, minimumSystemVersion("")
 	, operatingSystem("")
+	, phasedRollout()
 	, publicationDate()
 	, releaseNotesUrls()
 	, shortVersionString("")
-	, signature("")
+	, signatures()
 	, size(0)
+	, treeChunkSize(0)
 	, title("")
 	, url("")
 	, version("")
@@ -45,16 +49,19 @@ QGlitterAppcastItemPrivate::QGlitterAppcastItemPrivate(const QGlitterAppcastItem
 
 void QGlitterAppcastItemPrivate::clone(const QGlitterAppcastItemPrivate &other)
 {
+	chunkManifestUrl = other.chunkManifestUrl;
 	deltaFrom = other.deltaFrom;
 	descriptions = other.descriptions;
 	mimeType = other.mimeType;
 	minimumSystemVersion = other.minimumSystemVersion;
 	operatingSystem = other.operatingSystem;
+	phasedRollout = other.phasedRollout;
 	publicationDate = other.publicationDate;
 	releaseNotesUrls = other.releaseNotesUrls;
 	shortVersionString = other.shortVersionString;
-	signature = other.signature;
+	signatures = other.signatures;
 	size = other.size;
+	treeChunkSize = other.treeChunkSize;
 	title = other.title;
 	url = other.url;
 	version = other.version;
@@ -81,6 +88,18 @@ QGlitterAppcastItem &QGlitterAppcastItem::operator=(const QGlitterAppcastItem &r
 	return *this;
 }
 
+QString QGlitterAppcastItem::chunkManifestUrl() const
+{
+	const QGLITTER_D(QGlitterAppcastItem);
+	return d->chunkManifestUrl;
+}
+
+void QGlitterAppcastItem::setChunkManifestUrl(QString chunkManifestUrl)
+{
+	QGLITTER_D(QGlitterAppcastItem);
+	d->chunkManifestUrl = chunkManifestUrl;
+}
+
 QString QGlitterAppcastItem::deltaFrom() const
 {
 	const QGLITTER_D(QGlitterAppcastItem);
@@ -141,6 +160,42 @@ void QGlitterAppcastItem::setOperatingSystem(QString operatingSystem)
 	d->operatingSystem = operatingSystem;
 }
 
+QMap<int, int> QGlitterAppcastItem::phasedRollout() const
+{
+	const QGLITTER_D(QGlitterAppcastItem);
+	return d->phasedRollout;
+}
+
+void QGlitterAppcastItem::setPhasedRollout(QMap<int, int> phasedRollout)
+{
+	QGLITTER_D(QGlitterAppcastItem);
+	d->phasedRollout = phasedRollout;
+}
+
+// Items without a schedule are offered to everyone. A scheduled item without a date to measure
+// from never gets past its first stage, a broken pubDate mustn't release it to everyone.
+int QGlitterAppcastItem::rolloutPercentage(const QDateTime &currentTime) const
+{
+	const QGLITTER_D(QGlitterAppcastItem);
+
+	if (d->phasedRollout.isEmpty()) {
+		return 100;
+	}
+
+	if (!d->publicationDate.isValid()) {
+		return qBound(0, d->phasedRollout.constBegin().value(), 100);
+	}
+
+	qint64 hoursSincePublication = (currentTime.toMSecsSinceEpoch() - d->publicationDate.toMSecsSinceEpoch()) / (60 * 60 * 1000);
+
+	int percentage = 0;
+	for (QMap<int, int>::const_iterator i = d->phasedRollout.constBegin(); i != d->phasedRollout.constEnd() && i.key() <= hoursSincePublication; ++i) {
+		percentage = i.value();
+	}
+
+	return qBound(0, percentage, 100);
+}
+
 QDateTime QGlitterAppcastItem::publicationDate() const
 {
 	const QGLITTER_D(QGlitterAppcastItem);
@@ -185,13 +240,28 @@ void QGlitterAppcastItem::setShortVersionString(QString shortVersionString)
 QString QGlitterAppcastItem::signature() const
 {
 	const QGLITTER_D(QGlitterAppcastItem);
-	return d->signature;
+	return d->signatures.value(QGlitter::signatureAlgorithmName(QGlitter::DsaSha1));
 }
 
 void QGlitterAppcastItem::setSignature(QString signature)
+{
+	addSignature(QGlitter::signatureAlgorithmName(QGlitter::DsaSha1), signature);
+}
+
+QMap<QString, QString> QGlitterAppcastItem::signatures() const
+{
+	const QGLITTER_D(QGlitterAppcastItem);
+	return d->signatures;
+}
+
+void QGlitterAppcastItem::addSignature(QString algorithm, QString signature)
 {
 	QGLITTER_D(QGlitterAppcastItem);
-	d->signature = signature;
+	if (signature.isEmpty()) {
+		d->signatures.remove(algorithm);
+	} else {
+		d->signatures.insert(algorithm, signature);
+	}
 }
 
 int QGlitterAppcastItem::size() const
@@ -206,6 +276,18 @@ void QGlitterAppcastItem::setSize(int size)
 	d->size = size;
 }
 
+int QGlitterAppcastItem::treeChunkSize() const
+{
+	const QGLITTER_D(QGlitterAppcastItem);
+	return d->treeChunkSize;
+}
+
+void QGlitterAppcastItem::setTreeChunkSize(int treeChunkSize)
+{
+	QGLITTER_D(QGlitterAppcastItem);
+	d->treeChunkSize = treeChunkSize;
+}
+
 QString QGlitterAppcastItem::title() const
 {
 	const QGLITTER_D(QGlitterAppcastItem);
@@ -36,6 +36,10 @@ public:
 
 	QGlitterAppcastItem &operator=(const QGlitterAppcastItem &rhs);
 
+	// Per chunk digests of the enclosure, see treeChunkSize()
+	QString chunkManifestUrl() const;
+	void setChunkManifestUrl(QString chunkManifestUrl);
+
 	QString deltaFrom() const;
 	void setDeltaFrom(QString deltaFrom);
 
@@ -51,6 +55,12 @@ public:
 	QString operatingSystem() const;
 	void setOperatingSystem(QString operatingSystem);
 
+	// Maps hours after publicationDate() to the percentage of installations the item is offered to.
+	// Without a valid publicationDate() the item stays at the first stage of the schedule.
+	QMap<int, int> phasedRollout() const;
+	void setPhasedRollout(QMap<int, int> phasedRollout);
+	int rolloutPercentage(const QDateTime &currentTime) const;
+
 	QDateTime publicationDate() const;
 	void setPublicationDate(QDateTime publicationDate);
 
@@ -60,12 +70,20 @@ public:
 	QString shortVersionString() const;
 	void setShortVersionString(QString shortVersionString);
 
+	// signature() and setSignature() refer to the legacy DSA signature
 	QString signature() const;
 	void setSignature(QString signature);
 
+	QMap<QString, QString> signatures() const;
+	void addSignature(QString algorithm, QString signature);
+
 	int size() const;
 	void setSize(int size);
 
+	// Non-zero when the signatures cover a hash tree of chunks this size
+	int treeChunkSize() const;
+	void setTreeChunkSize(int treeChunkSize);
+
 	QString title() const;
 	void setTitle(QString title);
 
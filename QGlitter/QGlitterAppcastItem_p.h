@@ -35,16 +35,19 @@ public:
 
 	void clone(const QGlitterAppcastItemPrivate &other);
 
+	QString chunkManifestUrl;
 	QString deltaFrom;
 	QMap<QString, QString> descriptions;
 	QString mimeType;
 	QString minimumSystemVersion;
 	QString operatingSystem;
+	QMap<int, int> phasedRollout;
 	QDateTime publicationDate;
 	QMap<QString, QString> releaseNotesUrls;
 	QString shortVersionString;
-	QString signature;
+	QMap<QString, QString> signatures;
 	int size;
+	int treeChunkSize;
 	QString title;
 	QString url;
 	QString version;
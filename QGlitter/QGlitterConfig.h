@@ -31,3 +31,15 @@
 #		define QGLITTER_EXPORTED __attribute__ ((visibility ("default")))
 #	endif
 #endif
+
+#ifndef QGLITTER_WIDGETS_EXPORTED
+#	ifdef WIN32
+#		ifdef QGLITTER_WIDGETS_EXPORT_SYMBOLS
+#			define QGLITTER_WIDGETS_EXPORTED __declspec(dllexport)
+#		else
+#			define QGLITTER_WIDGETS_EXPORTED __declspec(dllimport)
+#		endif
+#	else
+#		define QGLITTER_WIDGETS_EXPORTED __attribute__ ((visibility ("default")))
+#	endif
+#endif
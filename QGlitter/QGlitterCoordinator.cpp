@@ -0,0 +1,221 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "QGlitterCoordinator.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStringList>
+#include <QTimer>
+
+static const int kConnectTimeout = 250;
+static const int kMaxReelectionDelay = 500;
+
+QGlitterCoordinator::QGlitterCoordinator(const QString &serverName, QObject *parent)
+	: QObject(parent)
+	, m_serverName(serverName)
+	, m_server(0)
+	, m_leader(0)
+	, m_followers()
+{
+}
+
+// Joins a running leader, or becomes the leader when there is none. When neither works
+// the process carries on alone, exactly as if it weren't coordinating at all.
+void QGlitterCoordinator::start()
+{
+	if (m_server || m_leader) {
+		return;
+	}
+
+	if (!connectToLeader()) {
+		listen();
+	}
+
+	emit roleChanged();
+}
+
+bool QGlitterCoordinator::isLeader() const
+{
+	return m_server != 0;
+}
+
+bool QGlitterCoordinator::isFollower() const
+{
+	return m_leader != 0;
+}
+
+void QGlitterCoordinator::publishAppcast(const QByteArray &data)
+{
+	broadcast("APPCAST " + data.toBase64());
+}
+
+void QGlitterCoordinator::publishAppcastError()
+{
+	broadcast("APPCAST-ERROR");
+}
+
+void QGlitterCoordinator::publishInstaller(const QString &url, int errorCode, const QString &installerPath)
+{
+	broadcast("INSTALLER " + url.toUtf8().toBase64() + " " + QByteArray::number(errorCode) + " " + installerPath.toUtf8().toBase64());
+}
+
+void QGlitterCoordinator::requestCheck()
+{
+	send("CHECK");
+}
+
+void QGlitterCoordinator::requestDownload(const QString &url)
+{
+	send("DOWNLOAD " + url.toUtf8().toBase64());
+}
+
+void QGlitterCoordinator::followerConnected()
+{
+	while (QLocalSocket *follower = m_server->nextPendingConnection()) {
+		m_followers.append(follower);
+		connect(follower, SIGNAL(readyRead()), this, SLOT(readyRead()));
+		connect(follower, SIGNAL(disconnected()), this, SLOT(followerDisconnected()));
+	}
+}
+
+void QGlitterCoordinator::followerDisconnected()
+{
+	QLocalSocket *follower = qobject_cast<QLocalSocket *>(sender());
+	if (!follower) {
+		return;
+	}
+
+	m_followers.removeAll(follower);
+	follower->deleteLater();
+}
+
+// The followers race to take over, the random delay keeps them from all trying at once
+void QGlitterCoordinator::leaderDisconnected()
+{
+	if (!m_leader) {
+		return;
+	}
+
+	m_leader->deleteLater();
+	m_leader = 0;
+
+	emit leaderLost();
+
+	QTimer::singleShot(qrand() % kMaxReelectionDelay, this, SLOT(start()));
+}
+
+void QGlitterCoordinator::readyRead()
+{
+	QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+	if (!socket) {
+		return;
+	}
+
+	while (socket->canReadLine()) {
+		handleMessage(socket->readLine().trimmed());
+	}
+}
+
+void QGlitterCoordinator::broadcast(const QByteArray &message)
+{
+	foreach (QLocalSocket *follower, m_followers) {
+		follower->write(message + "\n");
+	}
+}
+
+void QGlitterCoordinator::handleMessage(const QByteArray &message)
+{
+	QList<QByteArray> parts = message.split(' ');
+	QByteArray command = parts.takeFirst();
+
+	if (isLeader()) {
+		if (command == "CHECK") {
+			emit checkRequested();
+		} else if (command == "DOWNLOAD" && parts.size() == 1) {
+			emit downloadRequested(QString::fromUtf8(QByteArray::fromBase64(parts.at(0))));
+		}
+	} else {
+		if (command == "APPCAST" && parts.size() == 1) {
+			emit appcastReceived(QByteArray::fromBase64(parts.at(0)));
+		} else if (command == "APPCAST-ERROR") {
+			emit appcastFailed();
+		} else if (command == "INSTALLER" && parts.size() == 3) {
+			emit installerReceived(QString::fromUtf8(QByteArray::fromBase64(parts.at(0))), parts.at(1).toInt(), QString::fromUtf8(QByteArray::fromBase64(parts.at(2))));
+		}
+	}
+}
+
+bool QGlitterCoordinator::connectToLeader()
+{
+	QLocalSocket *leader = new QLocalSocket(this);
+	leader->connectToServer(m_serverName);
+	if (!leader->waitForConnected(kConnectTimeout)) {
+		delete leader;
+		return false;
+	}
+
+	m_leader = leader;
+	connect(m_leader, SIGNAL(readyRead()), this, SLOT(readyRead()));
+	connect(m_leader, SIGNAL(disconnected()), this, SLOT(leaderDisconnected()));
+
+	return true;
+}
+
+bool QGlitterCoordinator::listen()
+{
+	m_server = new QLocalServer(this);
+	connect(m_server, SIGNAL(newConnection()), this, SLOT(followerConnected()));
+
+#if QT_VERSION >= 0x050000
+	m_server->setSocketOptions(QLocalServer::UserAccessOption);
+#endif
+
+	if (m_server->listen(m_serverName)) {
+		return true;
+	}
+
+	if (m_server->serverError() == QAbstractSocket::AddressInUseError) {
+		// A process started at the same time may have taken the name since we last tried to connect
+		if (connectToLeader()) {
+			delete m_server;
+			m_server = 0;
+			return false;
+		}
+
+		// Nobody answers on the name, so whatever holds it was left behind by a process that died
+		QLocalServer::removeServer(m_serverName);
+		if (m_server->listen(m_serverName)) {
+			return true;
+		}
+	}
+
+	delete m_server;
+	m_server = 0;
+
+	return false;
+}
+
+void QGlitterCoordinator::send(const QByteArray &message)
+{
+	if (m_leader) {
+		m_leader->write(message + "\n");
+	}
+}
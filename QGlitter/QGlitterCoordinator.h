@@ -0,0 +1,79 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QString>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Lets the processes of one application and user share a single updater. The first
+// process to claim the local server becomes the leader and does all network work,
+// the others connect to it as followers and are sent the feed and installers it gets.
+class QGlitterCoordinator : public QObject
+{
+	Q_OBJECT
+public:
+	QGlitterCoordinator(const QString &serverName, QObject *parent = 0);
+
+	bool isLeader() const;
+	bool isFollower() const;
+
+	void publishAppcast(const QByteArray &data);
+	void publishAppcastError();
+	void publishInstaller(const QString &url, int errorCode, const QString &installerPath);
+
+	void requestCheck();
+	void requestDownload(const QString &url);
+
+public slots:
+	void start();
+
+signals:
+	void appcastReceived(const QByteArray &data);
+	void appcastFailed();
+	void installerReceived(const QString &url, int errorCode, const QString &installerPath);
+
+	void checkRequested();
+	void downloadRequested(const QString &url);
+	void leaderLost();
+	void roleChanged();
+
+private slots:
+	void followerConnected();
+	void followerDisconnected();
+	void leaderDisconnected();
+	void readyRead();
+
+private:
+	void broadcast(const QByteArray &message);
+	void handleMessage(const QByteArray &message);
+	bool connectToLeader();
+	bool listen();
+	void send(const QByteArray &message);
+
+	QString m_serverName;
+	QLocalServer *m_server;
+	QLocalSocket *m_leader;
+	QList<QLocalSocket *> m_followers;
+};
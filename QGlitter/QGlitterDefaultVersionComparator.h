@@ -20,10 +20,12 @@
 
 #pragma once
 
+#include "QGlitterConfig.h"
+
 #include <QString>
 
 namespace QGlitter {
 
-int defaultVersionComparator(const QString &lhs, const QString &rhs);
+QGLITTER_EXPORTED int defaultVersionComparator(const QString &lhs, const QString &rhs);
 
 }
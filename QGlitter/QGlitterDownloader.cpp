@@ -19,26 +19,124 @@
 // SOFTWARE.
 
 #include "QGlitterDownloader.h"
+#include "QGlitterAppcastItem.h"
 #include "Crypto/Crypto.h"
 
+#include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
 #include <QNetworkAccessManager>
+#include <QtConcurrentRun>
+
+static const int kMaxBadChunks = 8;
+static const int kMaxChunkRetries = 3;
+
+// A chunk manifest is the chunk size followed by one hex encoded leaf digest per line
+static bool parseChunkManifest(const QByteArray &data, int *chunkSize, QList<QByteArray> *digests)
+{
+	QList<QByteArray> lines = data.split('\n');
+	while (!lines.isEmpty() && lines.first().trimmed().isEmpty()) {
+		lines.removeFirst();
+	}
+
+	if (lines.isEmpty()) {
+		return false;
+	}
+
+	bool ok = false;
+	*chunkSize = lines.takeFirst().trimmed().toInt(&ok);
+	if (!ok || *chunkSize <= 0) {
+		return false;
+	}
+
+	foreach (const QByteArray &line, lines) {
+		if (line.trimmed().isEmpty()) {
+			continue;
+		}
+
+		QByteArray digest = QByteArray::fromHex(line.trimmed());
+		if (digest.size() != 32) {
+			return false;
+		}
+
+		digests->append(digest);
+	}
+
+	return !digests->isEmpty();
+}
+
+static int verifyInstaller(QString fileName, QString signature, QGlitterPublicKey publicKey, int treeChunkSize)
+{
+	QFile fileToVerify(fileName);
+	if (!fileToVerify.open(QIODevice::ReadOnly)) {
+		return QGlitterDownloader::DownloadedFileCouldNotBeRead;
+	}
+
+	if (signature.size() == 0 && publicKey.isNull()) {
+		return QGlitterDownloader::NoError;
+	}
+
+	QGlitter::CryptoResult result;
+	if (treeChunkSize > 0) {
+		result = QGlitter::verifyTree(fileToVerify, treeChunkSize, QByteArray::fromBase64(signature.toLatin1()), publicKey);
+	} else {
+		result = QGlitter::verifyDevice(fileToVerify, QByteArray::fromBase64(signature.toLatin1()), publicKey);
+	}
+
+	if (result.success) {
+		return QGlitterDownloader::NoError;
+	}
+
+	if (result.errorMessage.size()) {
+		qDebug() << result.errorMessage;
+	}
+
+	return QGlitterDownloader::SignatureVerificationFailure;
+}
 
 QGlitterDownloader::QGlitterDownloader(QObject *parent)
 	: QObject(parent)
-	, m_networkAccess(new QNetworkAccessManager(this))
-	, m_currentDownload(0)
+	, m_networkAccess(0)
+	, m_currentDownload()
+	, m_manifestDownload()
+	, m_chunkDownload()
 	, m_downloadedFile(0)
+	, m_verification(0)
 	, m_downloadedFileName("")
+	, m_treeChunkSize(0)
+	, m_url("")
+	, m_manifestUrl("")
+	, m_priority(QNetworkRequest::NormalPriority)
+	, m_isPaused(false)
+	, m_resumeOffset(0)
+	, m_currentChunk(0)
+	, m_chunkRetries(0)
 	, m_errorCode(QGlitterDownloader::Invalid)
 {
 }
 
+void QGlitterDownloader::setNetworkAccessManager(QNetworkAccessManager *networkAccessManager)
+{
+	m_networkAccess = networkAccessManager;
+}
+
 void QGlitterDownloader::setPublicKey(QByteArray publicKey)
 {
-	m_publicKey = publicKey;
+	// Parsed once here, every verification after that reuses the key
+	m_publicKey = QGlitterPublicKey(publicKey);
+}
+
+QNetworkRequest::Priority QGlitterDownloader::priority() const
+{
+	return m_priority;
+}
+
+void QGlitterDownloader::setPriority(QNetworkRequest::Priority priority)
+{
+	m_priority = priority;
 }
 
 int QGlitterDownloader::errorCode() const
@@ -51,38 +149,84 @@ QString QGlitterDownloader::installerFile() const
 	return m_downloadedFileName;
 }
 
-void QGlitterDownloader::downloadUpdate(QString url, QString signature)
+bool QGlitterDownloader::isPaused() const
 {
-	if (!m_networkAccess) {
-		return;
-	}
+	return m_isPaused;
+}
 
-	if (m_currentDownload) {
-		cancelDownload();
+void QGlitterDownloader::downloadUpdate(const QGlitterAppcastItem &appcastItem)
+{
+	// Only the signature made with the same kind of key as ours can be checked
+	QString algorithm = QGlitter::signatureAlgorithmName(m_publicKey.algorithm());
+	prepareDownload(appcastItem.url(), appcastItem.signatures().value(algorithm));
+	m_treeChunkSize = appcastItem.treeChunkSize();
+
+	// With a manifest every chunk is checked as it arrives, so the manifest is checked before anything else
+	if (m_treeChunkSize > 0 && appcastItem.chunkManifestUrl().size() && m_signature.size() && !m_publicKey.isNull()) {
+		m_manifestUrl = appcastItem.chunkManifestUrl();
+		fetchManifest();
+	} else {
+		startDownload();
 	}
+}
 
-	m_signature = signature;
+void QGlitterDownloader::downloadUpdate(QString url, QString signature)
+{
+	prepareDownload(url, signature);
+	startDownload();
+}
 
-	QString fileName = url.mid(url.lastIndexOf("/") + 1);
-	m_downloadedFileName = QDir::temp().absoluteFilePath(fileName);
+void QGlitterDownloader::verifySharedInstaller(const QGlitterAppcastItem &appcastItem, QString installerPath)
+{
+	QString algorithm = QGlitter::signatureAlgorithmName(m_publicKey.algorithm());
+	prepareDownload(appcastItem.url(), appcastItem.signatures().value(algorithm));
+	m_treeChunkSize = appcastItem.treeChunkSize();
+
+	// Whoever handed us the path can still write to it, the copy can't be swapped between check and install
+	QString fileName = QFileInfo(m_downloadedFileName).fileName();
+	m_downloadedFileName = QDir::temp().absoluteFilePath(QString("%1-%2").arg(QCoreApplication::applicationPid()).arg(fileName));
 
-	m_downloadedFile = new QFile(m_downloadedFileName, this);
-	if (!m_downloadedFile->open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+	QFile::remove(m_downloadedFileName);
+	if (!QFile::copy(installerPath, m_downloadedFileName)) {
+		abortDownload(QGlitterDownloader::DownloadedFileCouldNotBeRead);
 		return;
 	}
 
-	m_currentDownload = m_networkAccess->get(QNetworkRequest(QUrl(url)));
-	connect(m_currentDownload, SIGNAL(readyRead()), this, SLOT(readyRead()));
-	connect(m_currentDownload, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(error(QNetworkReply::NetworkError)));
-	connect(m_currentDownload, SIGNAL(finished()), this, SLOT(finished()));
-	connect(m_currentDownload, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(progress(qint64,qint64)));
+	startVerification();
 }
 
 void QGlitterDownloader::cancelDownload()
 {
 	m_downloadedFileName = "";
+	m_isPaused = false;
+	m_resumeOffset = 0;
+
+	// The worker thread can't be interrupted, verificationFinished() drops its result
+	m_verification = 0;
+
+	m_chunkDigests.clear();
+	m_chunkBuffer.clear();
+	m_currentChunk = 0;
+	m_badChunks.clear();
+	m_chunkRetries = 0;
+
+	if (m_manifestDownload) {
+		m_manifestDownload->disconnect(this);
+		m_manifestDownload->abort();
+		m_manifestDownload->deleteLater();
+		m_manifestDownload = 0;
+	}
+
+	if (m_chunkDownload) {
+		m_chunkDownload->disconnect(this);
+		m_chunkDownload->abort();
+		m_chunkDownload->deleteLater();
+		m_chunkDownload = 0;
+	}
 
 	if (m_currentDownload) {
+		// Aborting emits error() and finished(), which must not be reported as a failed download
+		m_currentDownload->disconnect(this);
 		if (m_currentDownload->isRunning() && m_currentDownload->error() == QNetworkReply::NoError) {
 			m_currentDownload->abort();
 		}
@@ -98,15 +242,238 @@ void QGlitterDownloader::cancelDownload()
 	}
 }
 
-void QGlitterDownloader::error(QNetworkReply::NetworkError code)
+void QGlitterDownloader::pauseDownload()
 {
-	if (code != QNetworkReply::NoError) {
-		m_errorCode = QGlitterDownloader::UnspecifiedError;
+	if (m_isPaused || (!m_currentDownload && !m_manifestDownload && !m_chunkDownload)) {
+		return;
+	}
 
-		emit downloadFinished(m_errorCode, "");
+	m_isPaused = true;
+
+	if (m_manifestDownload) {
+		m_manifestDownload->disconnect(this);
+		m_manifestDownload->abort();
+		m_manifestDownload->deleteLater();
+		m_manifestDownload = 0;
+	}
+
+	if (m_chunkDownload) {
+		m_chunkDownload->disconnect(this);
+		m_chunkDownload->abort();
+		m_chunkDownload->deleteLater();
+		m_chunkDownload = 0;
+	}
+
+	if (m_currentDownload) {
+		m_currentDownload->disconnect(this);
+		m_currentDownload->abort();
+		m_currentDownload->deleteLater();
+		m_currentDownload = 0;
+
+		// Only chunks that were already checked are kept, the partial one is fetched again
+		if (m_chunkDigests.size()) {
+			m_downloadedFile->resize(qint64(m_currentChunk) * m_treeChunkSize);
+			m_chunkBuffer.clear();
+		}
+
+		m_downloadedFile->flush();
+	}
+}
+
+void QGlitterDownloader::resumeDownload()
+{
+	if (!m_isPaused) {
+		return;
+	}
+
+	m_isPaused = false;
+
+	// Paused before the manifest arrived, nothing was written yet
+	if (!m_downloadedFile) {
+		fetchManifest();
+		return;
+	}
+
+	// The whole enclosure is in, only the repairs were left
+	if (m_chunkDigests.size() && m_currentChunk >= m_chunkDigests.size()) {
+		fetchNextBadChunk();
+		return;
+	}
+
+	startDownload(m_downloadedFile->size());
+}
+
+void QGlitterDownloader::abortDownload(int errorCode)
+{
+	m_errorCode = errorCode;
+
+	emit downloadFinished(m_errorCode, "");
+
+	cancelDownload();
+}
+
+void QGlitterDownloader::checkChunks(bool atEnd)
+{
+	// An empty enclosure still has a single, empty, chunk
+	while (m_chunkBuffer.size() >= m_treeChunkSize || (atEnd && (m_chunkBuffer.size() || m_currentChunk == 0))) {
+		QByteArray chunk = m_chunkBuffer.left(m_treeChunkSize);
+		m_chunkBuffer.remove(0, chunk.size());
+
+		if (m_currentChunk >= m_chunkDigests.size()) {
+			abortDownload(QGlitterDownloader::SignatureVerificationFailure);
+			return;
+		}
+
+		if (QGlitter::treeLeafDigest(chunk) != m_chunkDigests.at(m_currentChunk)) {
+			m_badChunks.append(m_currentChunk);
+		}
+
+		++m_currentChunk;
+	}
+
+	// A truncated transfer is repaired the same way as a corrupted one
+	if (atEnd) {
+		while (m_currentChunk < m_chunkDigests.size()) {
+			m_badChunks.append(m_currentChunk++);
+		}
+	}
 
+	// Past this point the source is broken rather than flaky, stop wasting the transfer
+	if (m_badChunks.size() > kMaxBadChunks) {
+		abortDownload(QGlitterDownloader::SignatureVerificationFailure);
+	}
+}
+
+void QGlitterDownloader::fetchNextBadChunk()
+{
+	qint64 offset = qint64(m_badChunks.first()) * m_treeChunkSize;
+
+	QNetworkRequest request((QUrl(m_url)));
+	request.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + "-" + QByteArray::number(offset + m_treeChunkSize - 1));
+	request.setPriority(m_priority);
+
+	m_chunkDownload = m_networkAccess->get(request);
+	connect(m_chunkDownload, SIGNAL(finished()), this, SLOT(chunkFinished()));
+}
+
+void QGlitterDownloader::finishChunkedDownload()
+{
+	if (m_downloadedFile) {
+		m_downloadedFile->close();
+		m_downloadedFile->deleteLater();
+		m_downloadedFile = 0;
+	}
+
+	// Every chunk matched the signed manifest, hashing the whole file again would prove nothing new
+	m_errorCode = QGlitterDownloader::NoError;
+
+	emit downloadFinished(m_errorCode, m_downloadedFileName);
+}
+
+void QGlitterDownloader::fetchManifest()
+{
+	QNetworkRequest request((QUrl(m_manifestUrl)));
+	request.setPriority(m_priority);
+
+	m_manifestDownload = m_networkAccess->get(request);
+	connect(m_manifestDownload, SIGNAL(finished()), this, SLOT(manifestFinished()));
+}
+
+void QGlitterDownloader::prepareDownload(QString url, QString signature)
+{
+	if (!m_networkAccess) {
+		m_networkAccess = new QNetworkAccessManager(this);
+	}
+
+	if (m_currentDownload || m_manifestDownload || m_chunkDownload || m_verification || m_isPaused) {
 		cancelDownload();
 	}
+
+	m_url = url;
+	m_manifestUrl = "";
+	m_signature = signature;
+	m_treeChunkSize = 0;
+
+	m_chunkDigests.clear();
+	m_chunkBuffer.clear();
+	m_currentChunk = 0;
+	m_badChunks.clear();
+	m_chunkRetries = 0;
+
+	QString fileName = url.mid(url.lastIndexOf("/") + 1);
+	m_downloadedFileName = QDir::temp().absoluteFilePath(fileName);
+}
+
+void QGlitterDownloader::startDownload(qint64 offset)
+{
+	if (!m_downloadedFile) {
+		m_downloadedFile = new QFile(m_downloadedFileName, this);
+		if (!m_downloadedFile->open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+			delete m_downloadedFile;
+			m_downloadedFile = 0;
+			abortDownload(QGlitterDownloader::DownloadedFileCouldNotBeRead);
+			return;
+		}
+	}
+
+	QNetworkRequest request((QUrl(m_url)));
+	request.setPriority(m_priority);
+	if (offset > 0) {
+		request.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + "-");
+	}
+
+	m_resumeOffset = offset;
+	m_downloadedFile->seek(offset);
+
+	m_currentDownload = m_networkAccess->get(request);
+	connect(m_currentDownload, SIGNAL(readyRead()), this, SLOT(readyRead()));
+	connect(m_currentDownload, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(error(QNetworkReply::NetworkError)));
+	connect(m_currentDownload, SIGNAL(finished()), this, SLOT(finished()));
+	connect(m_currentDownload, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(progress(qint64,qint64)));
+}
+
+void QGlitterDownloader::chunkFinished()
+{
+	QNetworkReply *reply = m_chunkDownload;
+	if (!reply || sender() != reply) {
+		return;
+	}
+
+	m_chunkDownload = 0;
+	reply->deleteLater();
+
+	int chunk = m_badChunks.first();
+	qint64 offset = qint64(chunk) * m_treeChunkSize;
+	QByteArray data = reply->readAll();
+
+	// A server that ignores the range sends the whole file instead of a partial response
+	bool isPartial = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 206;
+	if (reply->error() == QNetworkReply::NoError && isPartial && QGlitter::treeLeafDigest(data) == m_chunkDigests.at(chunk)) {
+		m_downloadedFile->seek(offset);
+		m_downloadedFile->write(data);
+		if (chunk == m_chunkDigests.size() - 1) {
+			m_downloadedFile->resize(offset + data.size());
+		}
+
+		m_badChunks.removeFirst();
+		m_chunkRetries = 0;
+	} else if (++m_chunkRetries > kMaxChunkRetries) {
+		abortDownload(reply->error() == QNetworkReply::NoError ? QGlitterDownloader::SignatureVerificationFailure : QGlitterDownloader::UnspecifiedError);
+		return;
+	}
+
+	if (m_badChunks.isEmpty()) {
+		finishChunkedDownload();
+	} else {
+		fetchNextBadChunk();
+	}
+}
+
+void QGlitterDownloader::error(QNetworkReply::NetworkError code)
+{
+	if (code != QNetworkReply::NoError) {
+		abortDownload(QGlitterDownloader::UnspecifiedError);
+	}
 }
 
 void QGlitterDownloader::finished()
@@ -119,6 +486,24 @@ void QGlitterDownloader::finished()
 		return;
 	}
 
+	if (m_chunkDigests.size()) {
+		checkChunks(true);
+		if (!m_currentDownload) {
+			return;
+		}
+
+		m_currentDownload->deleteLater();
+		m_currentDownload = 0;
+
+		if (m_badChunks.isEmpty()) {
+			finishChunkedDownload();
+		} else {
+			fetchNextBadChunk();
+		}
+
+		return;
+	}
+
 	if (m_downloadedFile) {
 		m_downloadedFile->close();
 		m_downloadedFile->deleteLater();
@@ -130,32 +515,101 @@ void QGlitterDownloader::finished()
 		m_currentDownload = 0;
 	}
 
-	QFile fileToVerify(m_downloadedFileName);
-	if (fileToVerify.open(QIODevice::ReadOnly)) {
-		if ((m_signature.size() == 0 && m_publicKey.size() == 0) || QGlitter::dsaVerify(fileToVerify, QByteArray::fromBase64(m_signature.toLatin1()), m_publicKey)) {
-			m_errorCode = QGlitterDownloader::NoError;
+	startVerification();
+}
 
-			emit downloadFinished(QGlitterDownloader::NoError, m_downloadedFileName);
-		} else {
-			if (QGlitter::errorMessage().size()) {
-				qDebug() << QGlitter::errorMessage();
-			}
+void QGlitterDownloader::startVerification()
+{
+	// Hashing a large installer takes a while, keep it off the GUI thread
+	m_verification = new QFutureWatcher<int>(this);
+	connect(m_verification, SIGNAL(finished()), this, SLOT(verificationFinished()));
+	m_verification->setFuture(QtConcurrent::run(verifyInstaller, m_downloadedFileName, m_signature, m_publicKey, m_treeChunkSize));
+}
+
+void QGlitterDownloader::manifestFinished()
+{
+	QNetworkReply *reply = m_manifestDownload;
+	if (!reply || sender() != reply) {
+		return;
+	}
+
+	m_manifestDownload = 0;
+	reply->deleteLater();
 
-			emit downloadFinished(QGlitterDownloader::SignatureVerificationFailure, "");
+	if (reply->error() != QNetworkReply::NoError) {
+		abortDownload(QGlitterDownloader::UnspecifiedError);
+		return;
+	}
+
+	// The manifest is only trusted once its root matches the signed tree digest
+	int chunkSize = 0;
+	QList<QByteArray> digests;
+	if (!parseChunkManifest(reply->readAll(), &chunkSize, &digests) || chunkSize != m_treeChunkSize) {
+		abortDownload(QGlitterDownloader::SignatureVerificationFailure);
+		return;
+	}
+
+	QGlitter::CryptoResult result = QGlitter::verifyDigest(QGlitter::treeSigningDigest(QGlitter::treeRootDigest(digests), chunkSize), QByteArray::fromBase64(m_signature.toLatin1()), m_publicKey);
+	if (!result.success) {
+		if (result.errorMessage.size()) {
+			qDebug() << result.errorMessage;
 		}
-	} else {
-		emit downloadFinished(QGlitterDownloader::DownloadedFileCouldNotBeRead, "");
+
+		abortDownload(QGlitterDownloader::SignatureVerificationFailure);
+		return;
 	}
 
-	fileToVerify.close();
+	m_chunkDigests = digests;
+
+	startDownload();
 }
 
 void QGlitterDownloader::progress(qint64 bytesReceived, qint64 bytesTotal)
 {
-	emit downloadProgress(bytesReceived, bytesTotal);
+	if (bytesTotal >= 0) {
+		bytesTotal += m_resumeOffset;
+	}
+
+	emit downloadProgress(bytesReceived + m_resumeOffset, bytesTotal);
 }
 
 void QGlitterDownloader::readyRead()
 {
-	m_downloadedFile->write(m_currentDownload->readAll());
+	// A server that ignores the range sends the whole file again, start over with it
+	if (m_resumeOffset > 0 && m_currentDownload->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 206) {
+		m_resumeOffset = 0;
+		m_downloadedFile->resize(0);
+		m_downloadedFile->seek(0);
+
+		m_chunkBuffer.clear();
+		m_currentChunk = 0;
+		m_badChunks.clear();
+	}
+
+	QByteArray data = m_currentDownload->readAll();
+	m_downloadedFile->write(data);
+
+	if (m_chunkDigests.size()) {
+		m_chunkBuffer.append(data);
+		checkChunks(false);
+	}
+}
+
+void QGlitterDownloader::verificationFinished()
+{
+	QFutureWatcher<int> *verification = static_cast<QFutureWatcher<int> *>(sender());
+	verification->deleteLater();
+
+	if (verification != m_verification) {
+		return;
+	}
+
+	m_verification = 0;
+	m_errorCode = verification->result();
+
+	if (m_errorCode == QGlitterDownloader::NoError) {
+		emit downloadFinished(m_errorCode, m_downloadedFileName);
+	} else {
+		emit downloadFinished(m_errorCode, "");
+	}
 }
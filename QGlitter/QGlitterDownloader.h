@@ -20,12 +20,21 @@
 
 #pragma once
 
-#include <QObject>
+#include "QGlitterConfig.h"
+#include "Crypto/Crypto.h"
+
+#include <QList>
+#include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QPointer>
 
 class QFile;
+class QGlitterAppcastItem;
+template <typename T> class QFutureWatcher;
 
-class QGlitterDownloader : public QObject
+class QGLITTER_EXPORTED QGlitterDownloader : public QObject
 {
 	Q_OBJECT
 public:
@@ -37,36 +46,80 @@ public:
 		DownloadedFileCouldNotBeRead,
 		UnspecifiedError,
 
+		// Too many recent failures, see QGlitterUpdater::downloadRetryPolicy()
+		TooManyFailures,
+
 		Invalid = 0xffff,
 	};
 
 	QGlitterDownloader(QObject *parent = 0);
 
+	void setNetworkAccessManager(QNetworkAccessManager *networkAccessManager);
 	void setPublicKey(QByteArray publicKey);
 
+	// Applies to requests made from here on, a transfer already underway keeps its priority
+	QNetworkRequest::Priority priority() const;
+	void setPriority(QNetworkRequest::Priority priority);
+
 	int errorCode() const;
 	QString installerFile() const;
+	bool isPaused() const;
 
 signals:
 	void downloadFinished(int errorCode, QString pathToFile);
 	void downloadProgress(qint64 bytesReceived, qint64 bytesTotal);
 
 public slots:
+	void downloadUpdate(const QGlitterAppcastItem &appcastItem);
 	void downloadUpdate(QString url, QString signature);
 	void cancelDownload();
 
+	// Checks an installer another process downloaded exactly as if it had been downloaded here,
+	// the result arrives through downloadFinished() with the path of a private copy
+	void verifySharedInstaller(const QGlitterAppcastItem &appcastItem, QString installerPath);
+
+	// Pausing keeps what has been downloaded so far, resuming asks the server for the rest
+	void pauseDownload();
+	void resumeDownload();
+
 private slots:
+	void chunkFinished();
 	void error(QNetworkReply::NetworkError code);
 	void finished();
+	void manifestFinished();
 	void progress(qint64 bytesReceived, qint64 bytesTotal);
 	void readyRead();
+	void verificationFinished();
 
 private:
-	QNetworkAccessManager *m_networkAccess;
-	QNetworkReply *m_currentDownload;
+	void abortDownload(int errorCode);
+	void checkChunks(bool atEnd);
+	void fetchNextBadChunk();
+	void finishChunkedDownload();
+	void fetchManifest();
+	void prepareDownload(QString url, QString signature);
+	void startDownload(qint64 offset = 0);
+	void startVerification();
+
+	QPointer<QNetworkAccessManager> m_networkAccess;
+	QPointer<QNetworkReply> m_currentDownload;
+	QPointer<QNetworkReply> m_manifestDownload;
+	QPointer<QNetworkReply> m_chunkDownload;
 	QFile *m_downloadedFile;
+	QFutureWatcher<int> *m_verification;
 	QString m_downloadedFileName;
 	QString m_signature;
-	QByteArray m_publicKey;
+	QGlitterPublicKey m_publicKey;
+	int m_treeChunkSize;
+	QString m_url;
+	QString m_manifestUrl;
+	QNetworkRequest::Priority m_priority;
+	bool m_isPaused;
+	qint64 m_resumeOffset;
+	QList<QByteArray> m_chunkDigests;
+	QByteArray m_chunkBuffer;
+	int m_currentChunk;
+	QList<int> m_badChunks;
+	int m_chunkRetries;
 	int m_errorCode;
 };
@@ -0,0 +1,217 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "QGlitterPushChannel.h"
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrl>
+
+static const int kInitialReconnectDelay = 1000;
+static const int kMaxReconnectDelay = 5 * 60 * 1000;
+
+// Announcements are a few short lines, a server sending more than this is broken or hostile
+static const int kMaxLineLength = 4096;
+static const int kMaxEventLength = 64 * 1024;
+
+QGlitterPushChannel::QGlitterPushChannel(QObject *parent)
+	: QObject(parent)
+	, m_networkAccess()
+	, m_reply()
+	, m_reconnectTimer(new QTimer(this))
+	, m_url("")
+	, m_buffer()
+	, m_eventType()
+	, m_eventData()
+	, m_lastEventId()
+	, m_reconnectDelay(kInitialReconnectDelay)
+{
+	m_reconnectTimer->setSingleShot(true);
+	connect(m_reconnectTimer, SIGNAL(timeout()), this, SLOT(connectToServer()));
+}
+
+QGlitterPushChannel::~QGlitterPushChannel()
+{
+	close();
+}
+
+void QGlitterPushChannel::open(QNetworkAccessManager *networkAccessManager, const QString &url)
+{
+	bool isOpen = m_reply || m_reconnectTimer->isActive();
+	if (isOpen && m_networkAccess == networkAccessManager && m_url == url) {
+		return;
+	}
+
+	close();
+
+	m_networkAccess = networkAccessManager;
+	m_url = url;
+	m_reconnectDelay = kInitialReconnectDelay;
+
+	connectToServer();
+}
+
+void QGlitterPushChannel::close()
+{
+	m_reconnectTimer->stop();
+
+	if (m_reply) {
+		m_reply->disconnect(this);
+		m_reply->abort();
+		m_reply->deleteLater();
+		m_reply = 0;
+	}
+}
+
+void QGlitterPushChannel::connectToServer()
+{
+	if (!m_networkAccess || m_url.isEmpty()) {
+		return;
+	}
+
+	QNetworkRequest request((QUrl(m_url)));
+	request.setRawHeader("Accept", "text/event-stream");
+	request.setRawHeader("Cache-Control", "no-cache");
+	request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+	if (m_lastEventId.size()) {
+		request.setRawHeader("Last-Event-ID", m_lastEventId);
+	}
+
+	m_buffer.clear();
+	m_eventType.clear();
+	m_eventData.clear();
+
+	m_reply = m_networkAccess->get(request);
+	connect(m_reply, SIGNAL(readyRead()), this, SLOT(readyRead()));
+	connect(m_reply, SIGNAL(finished()), this, SLOT(finished()));
+}
+
+// Polling on the check interval carries on regardless, so there's no hurry to get back
+void QGlitterPushChannel::finished()
+{
+	QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+	if (!reply || reply != m_reply) {
+		return;
+	}
+
+	readyRead();
+
+	m_reply->deleteLater();
+	m_reply = 0;
+
+	m_reconnectTimer->start(m_reconnectDelay + qrand() % (m_reconnectDelay / 2 + 1));
+	m_reconnectDelay = qMin(m_reconnectDelay * 2, kMaxReconnectDelay);
+}
+
+void QGlitterPushChannel::readyRead()
+{
+	if (!m_reply) {
+		return;
+	}
+
+	m_buffer += m_reply->readAll();
+
+	int lineEnd = -1;
+	while ((lineEnd = m_buffer.indexOf('\n')) >= 0) {
+		if (lineEnd > kMaxLineLength) {
+			dropConnection();
+			return;
+		}
+
+		QByteArray line = m_buffer.left(lineEnd);
+		m_buffer.remove(0, lineEnd + 1);
+
+		if (line.endsWith('\r')) {
+			line.chop(1);
+		}
+
+		if (line.isEmpty()) {
+			dispatchEvent();
+			continue;
+		}
+
+		// Lines starting with a colon are comments, servers send them to keep the connection alive
+		if (line.startsWith(':')) {
+			continue;
+		}
+
+		int colon = line.indexOf(':');
+		QByteArray field = colon >= 0 ? line.left(colon) : line;
+		QByteArray value = colon >= 0 ? line.mid(colon + 1) : QByteArray();
+		if (value.startsWith(' ')) {
+			value.remove(0, 1);
+		}
+
+		if (field == "event") {
+			m_eventType = value;
+		} else if (field == "data") {
+			if (m_eventData.size() + value.size() >= kMaxEventLength) {
+				dropConnection();
+				return;
+			}
+			m_eventData += value + "\n";
+		} else if (field == "id") {
+			m_lastEventId = value;
+		} else if (field == "retry") {
+			bool ok = false;
+			int delay = value.toInt(&ok);
+			if (ok && delay > 0) {
+				m_reconnectDelay = qMin(delay, kMaxReconnectDelay);
+			}
+		}
+	}
+
+	if (m_buffer.size() > kMaxLineLength) {
+		dropConnection();
+	}
+}
+
+// Aborting finishes the reply, which schedules a reconnect with the usual backoff
+void QGlitterPushChannel::dropConnection()
+{
+	m_buffer.clear();
+	m_eventType.clear();
+	m_eventData.clear();
+
+	m_reply->abort();
+}
+
+void QGlitterPushChannel::dispatchEvent()
+{
+	QByteArray eventType = m_eventType;
+	QByteArray eventData = m_eventData;
+	m_eventType.clear();
+	m_eventData.clear();
+
+	if (eventType != "release") {
+		return;
+	}
+
+	// The server is demonstrably up, the next disconnect starts the backoff over
+	m_reconnectDelay = kInitialReconnectDelay;
+
+	if (eventData.endsWith('\n')) {
+		eventData.chop(1);
+	}
+
+	emit releaseAnnounced(QString::fromUtf8(eventData));
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+// Keeps a Server-Sent Events stream open and reports every "release" event on it.
+// A long-poll endpoint that answers with a single event and closes works the same way.
+// Lost connections are retried with exponential backoff.
+class QGlitterPushChannel : public QObject
+{
+	Q_OBJECT
+public:
+	QGlitterPushChannel(QObject *parent = 0);
+	~QGlitterPushChannel();
+
+	void open(QNetworkAccessManager *networkAccessManager, const QString &url);
+	void close();
+
+signals:
+	void releaseAnnounced(const QString &data);
+
+private slots:
+	void connectToServer();
+	void finished();
+	void readyRead();
+
+private:
+	void dispatchEvent();
+	void dropConnection();
+
+	QPointer<QNetworkAccessManager> m_networkAccess;
+	QPointer<QNetworkReply> m_reply;
+	QTimer *m_reconnectTimer;
+	QString m_url;
+	QByteArray m_buffer;
+	QByteArray m_eventType;
+	QByteArray m_eventData;
+	QByteArray m_lastEventId;
+	int m_reconnectDelay;
+};
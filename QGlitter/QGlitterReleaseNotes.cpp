@@ -0,0 +1,255 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "QGlitterReleaseNotes.h"
+#include "QGlitterAppcastItem.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QUrl>
+
+static const quint32 kCacheFileMagic = 0x51474e31;
+static const int kMaxCachedNotes = 16;
+
+// Without a max-age the notes are still good for the alert that follows the prefetch
+static const qint64 kDefaultMaxAge = 5 * 60;
+
+static qint64 currentTime()
+{
+	return QDateTime::currentMSecsSinceEpoch() / 1000;
+}
+
+// Returns -1 when the reply may not be stored at all
+static qint64 maxAge(QNetworkReply *reply)
+{
+	qint64 age = kDefaultMaxAge;
+
+	foreach (QByteArray directive, reply->rawHeader("Cache-Control").split(',')) {
+		directive = directive.trimmed().toLower();
+		if (directive == "no-store") {
+			return -1;
+		} else if (directive == "no-cache") {
+			age = 0;
+		} else if (directive.startsWith("max-age=")) {
+			bool ok = false;
+			qint64 value = directive.mid(8).toLongLong(&ok);
+			if (ok) {
+				age = qMax<qint64>(0, value);
+			}
+		}
+	}
+
+	return age;
+}
+
+QGlitterReleaseNotes::QGlitterReleaseNotes(const QString &cacheDirectory, QObject *parent)
+	: QObject(parent)
+	, m_networkAccess()
+	, m_cacheDirectory(cacheDirectory)
+	, m_entries()
+	, m_pending()
+{
+}
+
+// Mirrors what the update alert shows: a description in the language, notes in the language,
+// any description, and only then any notes at all
+QString QGlitterReleaseNotes::releaseNotesUrl(const QGlitterAppcastItem &appcastItem, const QString &language)
+{
+	QMap<QString, QString> descriptions = appcastItem.descriptions();
+	QMap<QString, QString> releaseNotesUrls = appcastItem.releaseNotesUrls();
+
+	if (descriptions.contains(language)) {
+		return QString();
+	} else if (releaseNotesUrls.contains(language)) {
+		return releaseNotesUrls.value(language);
+	} else if (descriptions.size() || releaseNotesUrls.isEmpty()) {
+		return QString();
+	}
+
+	return releaseNotesUrls.begin().value();
+}
+
+void QGlitterReleaseNotes::setNetworkAccessManager(QNetworkAccessManager *networkAccessManager)
+{
+	m_networkAccess = networkAccessManager;
+}
+
+bool QGlitterReleaseNotes::cachedNotes(const QString &url, QByteArray *notes)
+{
+	Entry entry;
+	if (!loadEntry(url, &entry) || entry.expires <= currentTime()) {
+		return false;
+	}
+
+	*notes = entry.notes;
+	return true;
+}
+
+void QGlitterReleaseNotes::fetch(const QString &url)
+{
+	if (m_pending.contains(url) || !m_networkAccess) {
+		return;
+	}
+
+	QNetworkRequest request((QUrl(url)));
+
+	// Validation is done here, a cache on the application's manager would only get in the way
+	request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+	request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+
+	Entry entry;
+	if (loadEntry(url, &entry) && entry.etag.size()) {
+		request.setRawHeader("If-None-Match", entry.etag);
+	}
+
+	QNetworkReply *reply = m_networkAccess->get(request);
+	connect(reply, SIGNAL(finished()), this, SLOT(finished()));
+	m_pending.insert(url, reply);
+}
+
+void QGlitterReleaseNotes::finished()
+{
+	QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+	if (!reply) {
+		return;
+	}
+
+	reply->deleteLater();
+
+	QString url = m_pending.key(reply);
+	if (url.isEmpty()) {
+		return;
+	}
+	m_pending.remove(url);
+
+	Entry entry;
+	bool isCached = loadEntry(url, &entry);
+
+	if (reply->error() != QNetworkReply::NoError) {
+		// Stale notes still beat an empty alert
+		if (isCached) {
+			emit notesFetched(url, entry.notes);
+		} else {
+			emit fetchFailed(url);
+		}
+		return;
+	}
+
+	qint64 age = maxAge(reply);
+	int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+	if (statusCode == 304) {
+		if (!isCached) {
+			emit fetchFailed(url);
+			return;
+		}
+
+		entry.expires = currentTime() + qMax<qint64>(0, age);
+		storeEntry(url, entry, age >= 0);
+		emit notesFetched(url, entry.notes);
+		return;
+	}
+
+	entry.etag = reply->rawHeader("ETag");
+	entry.expires = currentTime() + qMax<qint64>(0, age);
+	entry.notes = reply->readAll();
+	storeEntry(url, entry, age >= 0);
+
+	emit notesFetched(url, entry.notes);
+}
+
+QString QGlitterReleaseNotes::cacheFile(const QString &url) const
+{
+	QByteArray name = QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Sha1).toHex();
+	return QDir(m_cacheDirectory).absoluteFilePath(QString::fromLatin1(name) + ".notes");
+}
+
+// The disk copy lets the next launch, or another process of the application, skip the fetch
+bool QGlitterReleaseNotes::loadEntry(const QString &url, Entry *entry)
+{
+	if (m_entries.contains(url)) {
+		*entry = m_entries.value(url);
+		return true;
+	}
+
+	if (m_cacheDirectory.isEmpty()) {
+		return false;
+	}
+
+	QFile file(cacheFile(url));
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_6);
+
+	quint32 magic = 0;
+	stream >> magic >> entry->etag >> entry->expires >> entry->notes;
+	if (magic != kCacheFileMagic || stream.status() != QDataStream::Ok) {
+		return false;
+	}
+
+	m_entries.insert(url, *entry);
+	return true;
+}
+
+void QGlitterReleaseNotes::storeEntry(const QString &url, const Entry &entry, bool toDisk)
+{
+	m_entries.insert(url, entry);
+
+	if (m_cacheDirectory.isEmpty()) {
+		return;
+	}
+
+	QString fileName = cacheFile(url);
+	if (!toDisk) {
+		QFile::remove(fileName);
+		return;
+	}
+
+	QDir cacheDirectory(m_cacheDirectory);
+	if (!cacheDirectory.mkpath(".")) {
+		return;
+	}
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_6);
+	stream << kCacheFileMagic << entry.etag << entry.expires << entry.notes;
+	file.close();
+
+	// Only the notes of the last few updates are worth keeping around
+	QFileInfoList cached = cacheDirectory.entryInfoList(QStringList("*.notes"), QDir::Files, QDir::Time);
+	for (int i = kMaxCachedNotes; i < cached.size(); ++i) {
+		QFile::remove(cached.at(i).absoluteFilePath());
+	}
+}
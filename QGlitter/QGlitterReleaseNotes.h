@@ -0,0 +1,77 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "QGlitterConfig.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+class QGlitterAppcastItem;
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Fetches release notes into memory and keeps the last few in a small disk cache. Cached notes
+// are used as long as the server's max-age allows, after that they're revalidated with their ETag.
+class QGLITTER_EXPORTED QGlitterReleaseNotes : public QObject
+{
+	Q_OBJECT
+public:
+	QGlitterReleaseNotes(const QString &cacheDirectory, QObject *parent = 0);
+
+	// The notes to fetch for an item, empty when it carries a description to show instead
+	static QString releaseNotesUrl(const QGlitterAppcastItem &appcastItem, const QString &language);
+
+	void setNetworkAccessManager(QNetworkAccessManager *networkAccessManager);
+
+	// Notes that are still fresh, false when they have to be fetched first
+	bool cachedNotes(const QString &url, QByteArray *notes);
+
+	// Fetching a url that is already on its way just waits for the same reply
+	void fetch(const QString &url);
+
+signals:
+	void notesFetched(const QString &url, const QByteArray &notes);
+	void fetchFailed(const QString &url);
+
+private slots:
+	void finished();
+
+private:
+	struct Entry
+	{
+		QByteArray etag;
+		qint64 expires;
+		QByteArray notes;
+	};
+
+	QString cacheFile(const QString &url) const;
+	bool loadEntry(const QString &url, Entry *entry);
+	void storeEntry(const QString &url, const Entry &entry, bool toDisk);
+
+	QPointer<QNetworkAccessManager> m_networkAccess;
+	QString m_cacheDirectory;
+	QHash<QString, Entry> m_entries;
+	QHash<QString, QNetworkReply *> m_pending;
+};
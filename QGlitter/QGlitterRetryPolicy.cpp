@@ -0,0 +1,157 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "QGlitterRetryPolicy.h"
+#include "QGlitterRetryPolicy_p.h"
+
+#include <QtGlobal>
+
+static const int kOneMinute = 60;
+static const int kOneHour = kOneMinute * 60;
+
+QGlitterRetryPolicyPrivate::QGlitterRetryPolicyPrivate()
+	: backoffMultiplier(2.0)
+	, circuitBreakerDuration(6 * kOneHour)
+	, failureThreshold(5)
+	, initialDelay(5 * kOneMinute)
+	, jitter(0.5)
+	, maximumDelay(6 * kOneHour)
+{
+}
+
+QGlitterRetryPolicyPrivate::QGlitterRetryPolicyPrivate(const QGlitterRetryPolicyPrivate &other)
+{
+	clone(other);
+}
+
+void QGlitterRetryPolicyPrivate::clone(const QGlitterRetryPolicyPrivate &other)
+{
+	backoffMultiplier = other.backoffMultiplier;
+	circuitBreakerDuration = other.circuitBreakerDuration;
+	failureThreshold = other.failureThreshold;
+	initialDelay = other.initialDelay;
+	jitter = other.jitter;
+	maximumDelay = other.maximumDelay;
+}
+
+QGlitterRetryPolicy::QGlitterRetryPolicy()
+	: QGlitterObject(new QGlitterRetryPolicyPrivate)
+{
+}
+
+QGlitterRetryPolicy::QGlitterRetryPolicy(const QGlitterRetryPolicy &other)
+	: QGlitterObject(new QGlitterRetryPolicyPrivate(*other.qglitter_d_func()))
+{
+}
+
+QGlitterRetryPolicy &QGlitterRetryPolicy::operator=(const QGlitterRetryPolicy &rhs)
+{
+	if (&rhs == this) {
+		return *this;
+	}
+
+	qglitter_d_func()->clone(*rhs.qglitter_d_func());
+
+	return *this;
+}
+
+double QGlitterRetryPolicy::backoffMultiplier() const
+{
+	const QGLITTER_D(QGlitterRetryPolicy);
+	return d->backoffMultiplier;
+}
+
+void QGlitterRetryPolicy::setBackoffMultiplier(double backoffMultiplier)
+{
+	QGLITTER_D(QGlitterRetryPolicy);
+	d->backoffMultiplier = qMax(1.0, backoffMultiplier);
+}
+
+int QGlitterRetryPolicy::circuitBreakerDuration() const
+{
+	const QGLITTER_D(QGlitterRetryPolicy);
+	return d->circuitBreakerDuration;
+}
+
+void QGlitterRetryPolicy::setCircuitBreakerDuration(int circuitBreakerDuration)
+{
+	QGLITTER_D(QGlitterRetryPolicy);
+	d->circuitBreakerDuration = qMax(0, circuitBreakerDuration);
+}
+
+int QGlitterRetryPolicy::failureThreshold() const
+{
+	const QGLITTER_D(QGlitterRetryPolicy);
+	return d->failureThreshold;
+}
+
+void QGlitterRetryPolicy::setFailureThreshold(int failureThreshold)
+{
+	QGLITTER_D(QGlitterRetryPolicy);
+	d->failureThreshold = qMax(0, failureThreshold);
+}
+
+int QGlitterRetryPolicy::initialDelay() const
+{
+	const QGLITTER_D(QGlitterRetryPolicy);
+	return d->initialDelay;
+}
+
+void QGlitterRetryPolicy::setInitialDelay(int initialDelay)
+{
+	QGLITTER_D(QGlitterRetryPolicy);
+	d->initialDelay = qMax(1, initialDelay);
+}
+
+double QGlitterRetryPolicy::jitter() const
+{
+	const QGLITTER_D(QGlitterRetryPolicy);
+	return d->jitter;
+}
+
+void QGlitterRetryPolicy::setJitter(double jitter)
+{
+	QGLITTER_D(QGlitterRetryPolicy);
+	d->jitter = qBound(0.0, jitter, 1.0);
+}
+
+int QGlitterRetryPolicy::maximumDelay() const
+{
+	const QGLITTER_D(QGlitterRetryPolicy);
+	return d->maximumDelay;
+}
+
+void QGlitterRetryPolicy::setMaximumDelay(int maximumDelay)
+{
+	QGLITTER_D(QGlitterRetryPolicy);
+	d->maximumDelay = qMax(1, maximumDelay);
+}
+
+int QGlitterRetryPolicy::backoffDelay(int failures) const
+{
+	const QGLITTER_D(QGlitterRetryPolicy);
+
+	double delay = d->initialDelay;
+	for (int i = 1; i < failures && delay < d->maximumDelay; ++i) {
+		delay *= d->backoffMultiplier;
+	}
+
+	return int(qMin<double>(delay, d->maximumDelay));
+}
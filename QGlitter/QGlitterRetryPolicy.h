@@ -0,0 +1,64 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "QGlitterObject.h"
+#include "QGlitterConfig.h"
+
+// How failed feed fetches and downloads are retried. Delays grow exponentially from
+// initialDelay() up to maximumDelay(), with up to jitter() of each delay randomised.
+// After failureThreshold() consecutive failures the circuit breaker suppresses all
+// attempts, interactive ones included, for circuitBreakerDuration() seconds.
+class QGlitterRetryPolicyPrivate;
+class QGLITTER_EXPORTED QGlitterRetryPolicy : public QGlitterObject
+{
+public:
+	QGlitterRetryPolicy();
+	QGlitterRetryPolicy(const QGlitterRetryPolicy &other);
+
+	QGlitterRetryPolicy &operator=(const QGlitterRetryPolicy &rhs);
+
+	double backoffMultiplier() const;
+	void setBackoffMultiplier(double backoffMultiplier);
+
+	int circuitBreakerDuration() const;
+	void setCircuitBreakerDuration(int circuitBreakerDuration);
+
+	// Zero disables the circuit breaker
+	int failureThreshold() const;
+	void setFailureThreshold(int failureThreshold);
+
+	int initialDelay() const;
+	void setInitialDelay(int initialDelay);
+
+	// Fraction between 0 and 1
+	double jitter() const;
+	void setJitter(double jitter);
+
+	int maximumDelay() const;
+	void setMaximumDelay(int maximumDelay);
+
+	// Delay in seconds before the next attempt after this many consecutive failures, without jitter
+	int backoffDelay(int failures) const;
+
+private:
+	QGLITTER_DECLARE_PRIVATE(QGlitterRetryPolicy);
+};
@@ -21,9 +21,9 @@
 #include "QGlitterUpdateAlert.h"
 #include "ui_QGlitterUpdateAlert.h"
 #include "QGlitterCommon.h"
+#include "QGlitterReleaseNotes.h"
 
 #include <QPixmap>
-#include <QFile>
 
 QGlitterUpdateAlert::QGlitterUpdateAlert(QWidget *parent, Qt::WindowFlags f)
 	: QDialog(parent, f | Qt::Dialog | Qt::CustomizeWindowHint | Qt::WindowCloseButtonHint)
@@ -31,6 +31,8 @@ QGlitterUpdateAlert::QGlitterUpdateAlert(QWidget *parent, Qt::WindowFlags f)
 	, m_defaultLanguage("en")
 	, m_skipVersion(false)
 	, m_automaticDownloads(false)
+	, m_releaseNotes()
+	, m_releaseNotesUrl("")
 {
 	if (!m_ui) {
 		return;
@@ -58,6 +60,11 @@ void QGlitterUpdateAlert::setDefaultLanguage(const QString &defaultLanguage)
 	m_defaultLanguage = defaultLanguage;
 }
 
+void QGlitterUpdateAlert::setReleaseNotes(QGlitterReleaseNotes *releaseNotes)
+{
+	m_releaseNotes = releaseNotes;
+}
+
 void QGlitterUpdateAlert::setAllowSkipping(bool allowSkipping)
 {
 	if (!m_ui) {
@@ -67,10 +74,22 @@ void QGlitterUpdateAlert::setAllowSkipping(bool allowSkipping)
 	m_ui->skipVersionButton->setVisible(allowSkipping);
 }
 
+// Usually the updater has fetched them already, otherwise this joins the fetch still underway
 void QGlitterUpdateAlert::downloadReleaseNotes(const QString &url)
 {
-    connect(&m_releaseNotesDownloader, SIGNAL(downloadFinished(int, QString)), this, SLOT(downloadFinished(int,QString)));
-    m_releaseNotesDownloader.downloadUpdate(url, QString());
+	if (!m_releaseNotes) {
+		return;
+	}
+
+	QByteArray notes;
+	if (m_releaseNotes->cachedNotes(url, &notes)) {
+		m_ui->releaseNotes->setHtml(QString::fromUtf8(notes));
+		return;
+	}
+
+	m_releaseNotesUrl = url;
+	connect(m_releaseNotes, SIGNAL(notesFetched(QString, QByteArray)), this, SLOT(releaseNotesFetched(QString, QByteArray)));
+	m_releaseNotes->fetch(url);
 }
 
 void QGlitterUpdateAlert::setAppcastItem(const QGlitterAppcastItem &appcastItem)
@@ -88,22 +107,17 @@ void QGlitterUpdateAlert::setAppcastItem(const QGlitterAppcastItem &appcastItem)
 	m_ui->messageLabel->setText(QString("<html><body><p>%1</p></body></html>").arg(message));
 
 	QMap<QString, QString> descriptions = appcastItem.descriptions();
-	QMap<QString, QString> releaseNotesUrls = appcastItem.releaseNotesUrls();
+	QString releaseNotesUrl = QGlitterReleaseNotes::releaseNotesUrl(appcastItem, m_defaultLanguage);
 
-	if (descriptions.find(m_defaultLanguage) != descriptions.end()) {
+	if (releaseNotesUrl.size()) {
+		downloadReleaseNotes(releaseNotesUrl);
+	} else if (descriptions.find(m_defaultLanguage) != descriptions.end()) {
 		m_ui->releaseNotes->setHtml(descriptions[m_defaultLanguage]);
-	} else if (releaseNotesUrls.find(m_defaultLanguage) != releaseNotesUrls.end()) {
-		downloadReleaseNotes(releaseNotesUrls[m_defaultLanguage]);
 	} else if (descriptions.size() > 0) {
 		QMapIterator<QString, QString> i(descriptions);
 		if (i.hasNext()) {
 			m_ui->releaseNotes->setHtml(i.next().value());
 		}
-	} else {
-		QMapIterator<QString, QString> i(releaseNotesUrls);
-		if (i.hasNext()) {
-			downloadReleaseNotes(i.next().value());
-		}
 	}
 }
 
@@ -146,13 +160,12 @@ void QGlitterUpdateAlert::toggleAutomaticDownloads()
 	m_automaticDownloads = !m_automaticDownloads;
 }
 
-void QGlitterUpdateAlert::downloadFinished(int errorCode, QString pathToFile)
+void QGlitterUpdateAlert::releaseNotesFetched(const QString &url, const QByteArray &notes)
 {
-    if (errorCode == QGlitterDownloader::NoError) {
-        QFile file(pathToFile);
-        if (file.open(QFile::ReadOnly)) {
-            m_ui->releaseNotes->setHtml(QString(file.readAll()));
-        }
-    }
-    disconnect(&m_releaseNotesDownloader, SIGNAL(downloadFinished(int, QString)), this, SLOT(downloadFinished(int,QString)));
+	if (url != m_releaseNotesUrl) {
+		return;
+	}
+
+	m_ui->releaseNotes->setHtml(QString::fromUtf8(notes));
+	disconnect(m_releaseNotes, SIGNAL(notesFetched(QString, QByteArray)), this, SLOT(releaseNotesFetched(QString, QByteArray)));
 }
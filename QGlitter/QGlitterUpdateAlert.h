@@ -23,8 +23,9 @@
 #include "QGlitterAppcastItem.h"
 
 #include <QDialog>
-#include <QGlitterDownloader.h>
+#include <QPointer>
 
+class QGlitterReleaseNotes;
 class QPixmap;
 class Ui_QGlitterUpdateAlert;
 
@@ -46,12 +47,14 @@ public:
 
 	void setDefaultLanguage(const QString &defaultLanguage);
 
+	void setReleaseNotes(QGlitterReleaseNotes *releaseNotes);
+
 	bool skipVersion();
 
 private slots:
 	void toggleSkipVersion();
 	void toggleAutomaticDownloads();
-    void downloadFinished(int errorCode, QString pathToFile);
+	void releaseNotesFetched(const QString &url, const QByteArray &notes);
 
 private:
 	Ui_QGlitterUpdateAlert *m_ui;
@@ -60,7 +63,8 @@ private:
 	QGlitterAppcastItem m_appcastItem;
 	bool m_skipVersion;
 	bool m_automaticDownloads;
-    QGlitterDownloader m_releaseNotesDownloader;
-    
-    void downloadReleaseNotes(const QString &url);
+	QPointer<QGlitterReleaseNotes> m_releaseNotes;
+	QString m_releaseNotesUrl;
+
+	void downloadReleaseNotes(const QString &url);
 };
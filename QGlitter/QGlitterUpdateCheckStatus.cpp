@@ -22,12 +22,11 @@
 #include "ui_QGlitterUpdateStatus.h"
 #include "QGlitterCommon.h"
 
-#include <QNetworkReply>
+#include <QPixmap>
 
 QGlitterUpdateCheckStatus::QGlitterUpdateCheckStatus(QWidget *parent, Qt::WindowFlags f)
 	: QDialog(parent, f | Qt::Dialog | Qt::CustomizeWindowHint | Qt::WindowCloseButtonHint)
 	, m_ui(new Ui_QGlitterUpdateStatus)
-	, m_networkReply(0)
 {
 	if (!m_ui) {
 		return;
@@ -63,16 +62,6 @@ void QGlitterUpdateCheckStatus::setApplicationIcon(const QPixmap *applicationIco
 	m_ui->iconLabel->setPixmap(applicationIcon->scaled(m_ui->iconLabel->size()));
 }
 
-void QGlitterUpdateCheckStatus::setNetworkReply(QNetworkReply *networkReply)
-{
-	if (!networkReply) {
-		return;
-	}
-
-	connect(networkReply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(downloadProgress(qint64, qint64)));
-	m_networkReply = networkReply;
-}
-
 void QGlitterUpdateCheckStatus::downloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
 	if (!m_ui) {
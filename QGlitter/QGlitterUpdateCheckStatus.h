@@ -22,7 +22,6 @@
 
 #include <QDialog>
 
-class QNetworkReply;
 class QPixmap;
 class Ui_QGlitterUpdateStatus;
 
@@ -34,15 +33,11 @@ public:
 	~QGlitterUpdateCheckStatus();
 
 	void setApplicationIcon(const QPixmap *applicationIcon);
-	void setNetworkReply(QNetworkReply *networkReply);
 
 public slots:
-	void noUpdatesAvailable();
-
-private slots:
 	void downloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	void noUpdatesAvailable();
 
 private:
 	Ui_QGlitterUpdateStatus *m_ui;
-	QNetworkReply *m_networkReply;
 };
@@ -21,22 +21,36 @@
 #include "QGlitterUpdater.h"
 #include "QGlitterUpdater_p.h"
 #include "QGlitterAppcast.h"
+#include "QGlitterCoordinator.h"
 #include "QGlitterDefaultVersionComparator.h"
 #include "QGlitterDownloader.h"
-#include "QGlitterUpdateAlert.h"
-#include "QGlitterUpdateCheckStatus.h"
-#include "QGlitterUpdateStatus.h"
-#include "QGlitterAutomaticUpdateAlert.h"
-#include "Crypto/Crypto.h"
+#include "QGlitterPushChannel.h"
+#include "QGlitterReleaseNotes.h"
 #include "Platform/Platform.h"
 
+#include <QBuffer>
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFutureWatcher>
 #include <QLocale>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QSettings>
 #include <QTimer>
+#include <QUrl>
+#include <QtConcurrentRun>
+
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#endif
+
+#if QT_VERSION >= 0x050A00
+#include <QRandomGenerator>
+#endif
 
 static const char * const kIsFirstLaunch = "QGlitter/IsFirstLaunch";
 static const char * const kAutomaticUpdateCheck = "QGlitter/AutomaticCheck";
@@ -44,36 +58,417 @@ static const char * const kAutomaticDownload = "QGlitter/AutomaticDownload";
 static const char * const kCheckInterval = "QGlitter/CheckInterval";
 static const char * const kIgnoredVersions = "QGlitter/IgnoredVersions";
 static const char * const kLastCheckTime = "QGlitter/LastUpdateCheck";
+static const char * const kRolloutBucket = "QGlitter/RolloutBucket";
+static const char * const kNextCheckTime = "QGlitter/NextUpdateCheck";
+static const char * const kFeedFailures = "QGlitter/FeedFailures";
+static const char * const kLastFeedFailure = "QGlitter/LastFeedFailure";
+static const char * const kDownloadFailures = "QGlitter/DownloadFailures";
+static const char * const kLastDownloadFailure = "QGlitter/LastDownloadFailure";
 
 static const qint64 kNeverUpdated = 0;
 static const int kOneHour = 60 * 60;
 static const int kOneDay = kOneHour * 24;
+static const int kOneWeek = kOneDay * 7;
+static const int kStartupCheckDelay = 10;
+static const int kStartupJitter = 10 * 60;
+static const int kAnnouncementJitter = 30;
+
+static bool readAppcast(QGlitterAppcast *appcast, QByteArray data)
+{
+	QBuffer buffer(&data);
+	if (!buffer.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	return appcast->read(&buffer);
+}
+
+// Uniformly distributed in [0, maximum]
+static int randomUpTo(int maximum)
+{
+	if (maximum <= 0) {
+		return 0;
+	}
+
+#if QT_VERSION >= 0x050A00
+	return QRandomGenerator::global()->bounded(maximum + 1);
+#else
+	// qrand() starts from the same seed in every process, which would defeat the point
+	static bool seeded = false;
+	if (!seeded) {
+		qsrand(uint(QDateTime::currentMSecsSinceEpoch()) ^ uint(QCoreApplication::applicationPid()));
+		seeded = true;
+	}
+
+	quint64 value = (quint64(qrand()) << 16) ^ quint64(qrand());
+	return int(value % quint64(maximum + 1));
+#endif
+}
+
+// Server hints are in seconds, 0 when the reply has none.
+// Cache-Control: max-age replaces the check interval, Retry-After can only push the next check further out.
+static qint64 maxAgeHint(QNetworkReply *reply)
+{
+	foreach (QByteArray directive, reply->rawHeader("Cache-Control").split(',')) {
+		directive = directive.trimmed();
+		if (directive.startsWith("max-age=")) {
+			bool ok = false;
+			qint64 maxAge = directive.mid(8).toLongLong(&ok);
+			if (ok) {
+				return qBound<qint64>(kOneHour, maxAge, kOneWeek);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static qint64 retryAfterHint(QNetworkReply *reply)
+{
+	QByteArray retryAfter = reply->rawHeader("Retry-After").trimmed();
+	if (retryAfter.isEmpty()) {
+		return 0;
+	}
+
+	bool ok = false;
+	qint64 delay = retryAfter.toLongLong(&ok);
+	if (!ok) {
+		QDateTime date = QLocale::c().toDateTime(QString::fromLatin1(retryAfter.left(25)), "ddd, dd MMM yyyy hh:mm:ss");
+		date.setTimeSpec(Qt::UTC);
+		delay = date.isValid() ? (date.toMSecsSinceEpoch() - QDateTime::currentMSecsSinceEpoch()) / 1000 : 0;
+	}
+
+	return qBound<qint64>(0, delay, kOneWeek);
+}
+
+static bool hasRunningReplies(QNetworkAccessManager *networkAccess)
+{
+	foreach (QNetworkReply *reply, networkAccess->findChildren<QNetworkReply *>()) {
+		if (reply->isRunning()) {
+			return true;
+		}
+	}
+
+	return false;
+}
 
-static const int kBackgroundDownload = 0;
-static const int kInteractiveDownload = 1;
+static bool isCircuitOpen(const QGlitterRetryPolicy &policy, int failures, qint64 lastFailure)
+{
+	if (policy.failureThreshold() == 0 || failures < policy.failureThreshold()) {
+		return false;
+	}
+
+	return QDateTime::currentMSecsSinceEpoch() / 1000 < lastFailure + policy.circuitBreakerDuration();
+}
+
+// Once the circuit breaker trips the next attempt waits for it to close again
+static int retryDelay(const QGlitterRetryPolicy &policy, int failures)
+{
+	int delay = policy.backoffDelay(failures);
+	delay -= randomUpTo(int(delay * policy.jitter()));
+
+	if (policy.failureThreshold() > 0 && failures >= policy.failureThreshold()) {
+		delay = qMax(delay, policy.circuitBreakerDuration());
+	}
+
+	return delay;
+}
 
 QGlitterUpdaterPrivate::QGlitterUpdaterPrivate()
-	: applicationIcon(0)
-	, internalVersion()
+	: internalVersion()
 	, automaticCheck(true)
 	, automaticDownload(false)
+	, speculativeDownload(false)
+	, dismissPolicy(QGlitterUpdater::PauseDownload)
 	, checkInterval(kOneDay)
+	, checkJitter(kOneHour)
 	, defaultLanguage("en")
 	, feedUrl("")
+	, pushUrl("")
+	, rolloutBucket(-1)
 	, allowVersionSkipping(true)
 	, allowDelayInstallUntilQuit(true)
 	, isCheckingForUpdates(false)
 	, isInteractive(false)
 	, lastUpdateCheck(kNeverUpdated)
+	, nextUpdateCheck(kNeverUpdated)
+	, serverMaxAge(0)
+	, serverRetryAfter(0)
+	, feedRetryPolicy()
+	, feedFailures(0)
+	, lastFeedFailure(0)
+	, downloadRetryPolicy()
+	, downloadFailures(0)
+	, lastDownloadFailure(0)
+	, retryItem()
+	, downloadRetryTimer(0)
 	, networkAccess(0)
+	, ownsNetworkAccess(false)
+	, releaseNotesFetcher(0)
 	, settings(0)
 	, timer(0)
 	, downloader(0)
+	, appcast(0)
+	, parsingAppcast(0)
+	, appcastParser(0)
 	, pendingUpdate("")
+	, isSpeculative(false)
+	, speculativeInstaller("")
+	, coordinateProcesses(false)
+	, processCoordinator(0)
+	, isDownloading(false)
+	, downloadedUrl("")
+	, sharedInstaller("")
+	, isVerifyingSharedInstaller(false)
+	, isSharedAppcast(false)
+	, pushChannel(0)
+	, isScheduled(false)
 	, versionComparator(0)
 {
 }
 
+QNetworkAccessManager *QGlitterUpdaterPrivate::networkAccessManager()
+{
+	QGLITTER_Q(QGlitterUpdater);
+
+	if (!networkAccess) {
+		networkAccess = new QNetworkAccessManager(q);
+		ownsNetworkAccess = true;
+	}
+
+	return networkAccess;
+}
+
+QGlitterReleaseNotes *QGlitterUpdaterPrivate::releaseNotes()
+{
+	QGLITTER_Q(QGlitterUpdater);
+
+	if (!releaseNotesFetcher) {
+		releaseNotesFetcher = new QGlitterReleaseNotes(QDir(cacheDirectory()).absoluteFilePath("ReleaseNotes"), q);
+	}
+
+	releaseNotesFetcher->setNetworkAccessManager(networkAccessManager());
+	return releaseNotesFetcher;
+}
+
+QSettings *QGlitterUpdaterPrivate::loadSettings()
+{
+	QGLITTER_Q(QGlitterUpdater);
+
+	if (settings) {
+		return settings;
+	}
+
+	settings = new QSettings(QSettings::UserScope, "QGlitter", settingsDomain(), q);
+
+	automaticCheck = settings->value(kAutomaticUpdateCheck, true).toBool();
+	automaticDownload = settings->value(kAutomaticDownload, false).toBool();
+	checkInterval = settings->value(kCheckInterval, checkInterval).toInt();
+	lastUpdateCheck = settings->value(kLastCheckTime, kNeverUpdated).value<qint64>();
+	nextUpdateCheck = settings->value(kNextCheckTime, kNeverUpdated).value<qint64>();
+	feedFailures = settings->value(kFeedFailures, 0).toInt();
+	lastFeedFailure = settings->value(kLastFeedFailure, 0).value<qint64>();
+	downloadFailures = settings->value(kDownloadFailures, 0).toInt();
+	lastDownloadFailure = settings->value(kLastDownloadFailure, 0).value<qint64>();
+	ignoredVersions = settings->value(kIgnoredVersions, QStringList()).toStringList();
+
+	// Drawn once per installation so an installation stays in or out of a phased rollout from check to check
+	rolloutBucket = settings->value(kRolloutBucket, -1).toInt();
+	if (rolloutBucket < 0 || rolloutBucket > 99) {
+		rolloutBucket = randomUpTo(99);
+		settings->setValue(kRolloutBucket, rolloutBucket);
+	}
+
+	return settings;
+}
+
+QGlitterCoordinator *QGlitterUpdaterPrivate::coordinator()
+{
+	QGLITTER_Q(QGlitterUpdater);
+
+	if (!coordinateProcesses || processCoordinator) {
+		return processCoordinator;
+	}
+
+	// Local server names are machine wide, the home directory keeps users apart
+	QByteArray key = (settingsDomain() + QDir::homePath()).toUtf8();
+	QString serverName = "qglitter-" + QString(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex().left(16));
+
+#ifndef Q_OS_WIN
+	// A socket file in the shared temp directory can be claimed by any user, put it where only we can get at it.
+	// Without such a directory the process carries on alone.
+	QString socketDirectory = QDir::home().absoluteFilePath(".qglitter");
+	if (!QDir().mkpath(socketDirectory) || !QFile::setPermissions(socketDirectory, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner)) {
+		return 0;
+	}
+
+	serverName = QDir(socketDirectory).absoluteFilePath(serverName + ".sock");
+#endif
+
+	processCoordinator = new QGlitterCoordinator(serverName, q);
+	QObject::connect(processCoordinator, SIGNAL(checkRequested()), q, SLOT(followerCheckRequested()));
+	QObject::connect(processCoordinator, SIGNAL(downloadRequested(QString)), q, SLOT(followerDownloadRequested(QString)));
+	QObject::connect(processCoordinator, SIGNAL(appcastReceived(QByteArray)), q, SLOT(sharedAppcastReceived(QByteArray)));
+	QObject::connect(processCoordinator, SIGNAL(appcastFailed()), q, SLOT(sharedAppcastFailed()));
+	QObject::connect(processCoordinator, SIGNAL(installerReceived(QString, int, QString)), q, SLOT(sharedInstallerReceived(QString, int, QString)));
+	QObject::connect(processCoordinator, SIGNAL(leaderLost()), q, SLOT(leaderLost()));
+	QObject::connect(processCoordinator, SIGNAL(roleChanged()), q, SLOT(roleChanged()));
+	processCoordinator->start();
+
+	return processCoordinator;
+}
+
+// An installer downloaded by the leader process takes the place of our own downloader's
+QString QGlitterUpdaterPrivate::installerPath() const
+{
+	if (sharedInstaller.size()) {
+		return sharedInstaller;
+	}
+
+	if (downloader->errorCode() != QGlitterDownloader::NoError) {
+		return QString();
+	}
+
+	return downloader->installerFile();
+}
+
+QString QGlitterUpdaterPrivate::cacheDirectory() const
+{
+#if QT_VERSION >= 0x050000
+	return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).absoluteFilePath("QGlitter");
+#else
+	// Qt 4 keeps the cache location in QtGui, which qglitter-core doesn't link against
+	return QDir::home().absoluteFilePath(".qglitter/" + settingsDomain());
+#endif
+}
+
+QString QGlitterUpdaterPrivate::settingsDomain() const
+{
+	return QString("%1.%2").arg(qApp->organizationDomain()).arg(qApp->applicationName().replace(' ', ""));
+}
+
+// Only processes that do their own checks listen, followers hear about releases from their leader
+void QGlitterUpdaterPrivate::updatePushChannel()
+{
+	QGLITTER_Q(QGlitterUpdater);
+
+	QGlitterCoordinator *processCoordinator = coordinator();
+	bool listen = isScheduled && automaticCheck && pushUrl.size() && !(processCoordinator && processCoordinator->isFollower());
+
+	if (!listen) {
+		if (pushChannel) {
+			pushChannel->close();
+		}
+		return;
+	}
+
+	if (!pushChannel) {
+		pushChannel = new QGlitterPushChannel(q);
+		QObject::connect(pushChannel, SIGNAL(releaseAnnounced(QString)), q, SLOT(releaseAnnounced()));
+	}
+
+	pushChannel->open(networkAccessManager(), pushUrl);
+}
+
+// Followers leave the network to their leader, and a download the user asked for is never displaced
+void QGlitterUpdaterPrivate::startSpeculativeDownload(const QGlitterAppcastItem &appcastItem)
+{
+	QGlitterCoordinator *processCoordinator = coordinator();
+	if ((processCoordinator && processCoordinator->isFollower()) || (isDownloading && !isSpeculative)) {
+		return;
+	}
+
+	// Found again after being dismissed, carry on from where it was paused
+	if (isSpeculative && retryItem.url() == appcastItem.url()) {
+		if (downloader->isPaused()) {
+			isDownloading = true;
+			downloader->setNetworkAccessManager(networkAccessManager());
+			downloader->resumeDownload();
+		}
+		return;
+	}
+
+	discardSpeculativeDownload();
+
+	if (isCircuitOpen(downloadRetryPolicy, downloadFailures, lastDownloadFailure)) {
+		return;
+	}
+
+	downloadRetryTimer->stop();
+	retryItem = appcastItem;
+	sharedInstaller = "";
+	isSpeculative = true;
+	isDownloading = true;
+
+	downloader->setNetworkAccessManager(networkAccessManager());
+	downloader->setPriority(QNetworkRequest::LowPriority);
+	downloader->downloadUpdate(appcastItem);
+}
+
+void QGlitterUpdaterPrivate::discardSpeculativeDownload()
+{
+	if (!isSpeculative) {
+		return;
+	}
+
+	downloader->cancelDownload();
+	if (speculativeInstaller.size()) {
+		QFile::remove(speculativeInstaller);
+	}
+
+	speculativeInstaller = "";
+	isSpeculative = false;
+	isDownloading = false;
+	retryItem = QGlitterAppcastItem();
+}
+
+// The enclosure and release notes usually live on a CDN rather than the feed's host. Setting up
+// those connections while the user reads the alert takes DNS, TCP and TLS out of the download.
+// Qt 4 can't open a connection without a request, there a HEAD request stands in and the manager
+// keeps its connection alive for the download that follows.
+void QGlitterUpdaterPrivate::warmUpConnections(const QGlitterAppcastItem &appcastItem)
+{
+	QGlitterCoordinator *processCoordinator = coordinator();
+	if (processCoordinator && processCoordinator->isFollower()) {
+		return;
+	}
+
+	QStringList urls = appcastItem.releaseNotesUrls().values();
+	urls << appcastItem.url() << appcastItem.chunkManifestUrl();
+
+	QStringList warmedUp;
+	foreach (const QString &url, urls) {
+		QUrl hostUrl(url);
+		QString scheme = hostUrl.scheme().toLower();
+		if (hostUrl.host().isEmpty() || (scheme != "http" && scheme != "https")) {
+			continue;
+		}
+
+		QString origin = scheme + "://" + hostUrl.host() + ":" + QString::number(hostUrl.port(-1));
+		if (warmedUp.contains(origin)) {
+			continue;
+		}
+		warmedUp << origin;
+
+#if QT_VERSION >= 0x050200
+		if (scheme == "https") {
+#ifndef QT_NO_SSL
+			networkAccessManager()->connectToHostEncrypted(hostUrl.host(), hostUrl.port(443));
+#endif
+		} else {
+			networkAccessManager()->connectToHost(hostUrl.host(), hostUrl.port(80));
+		}
+#else
+		QNetworkRequest request(hostUrl);
+		request.setPriority(QNetworkRequest::LowPriority);
+		request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+
+		QNetworkReply *reply = networkAccessManager()->head(request);
+		QObject::connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+#endif
+	}
+}
+
 QGlitterUpdater::QGlitterUpdater(bool allowVersionSkipping, bool allowDelayInstalUntilQuit, int checkInterval, QObject *parent)
 	: QObject(parent)
 	, QGlitterObject(new QGlitterUpdaterPrivate)
@@ -84,8 +479,6 @@ QGlitterUpdater::QGlitterUpdater(bool allowVersionSkipping, bool allowDelayInsta
 	d->allowVersionSkipping = allowVersionSkipping;
 	d->allowDelayInstallUntilQuit = allowDelayInstalUntilQuit;
 
-	QGlitter::cryptoInit();
-
 	d->defaultLanguage = QLocale::system().name();
 	d->defaultLanguage.truncate(d->defaultLanguage.lastIndexOf('_'));
 
@@ -94,80 +487,99 @@ QGlitterUpdater::QGlitterUpdater(bool allowVersionSkipping, bool allowDelayInsta
 	d->timer = new QTimer(this);
 	connect(d->timer, SIGNAL(timeout()), this, SLOT(updateTimeout()));
 
-	QString settingsDomain = QString("%1.%2").arg(qApp->organizationDomain()).arg(qApp->applicationName().replace(' ', ""));
-	d->settings = new QSettings(QSettings::UserScope, "QGlitter", settingsDomain, this);
+	d->downloadRetryTimer = new QTimer(this);
+	d->downloadRetryTimer->setSingleShot(true);
+	connect(d->downloadRetryTimer, SIGNAL(timeout()), this, SLOT(retryDownload()));
 
-	d->automaticCheck = d->settings->value(kAutomaticUpdateCheck, true).toBool();
-	d->automaticDownload = d->settings->value(kAutomaticDownload, false).toBool();
-	d->checkInterval = d->settings->value(kCheckInterval, kOneDay).toInt();
-	d->lastUpdateCheck = d->settings->value(kLastCheckTime, kNeverUpdated).value<qint64>();
-	d->ignoredVersions = d->settings->value(kIgnoredVersions, QStringList()).toStringList();
-
-	if (!d->settings->value(kIsFirstLaunch, true).toBool()) {
-		if (d->lastUpdateCheck == kNeverUpdated) {
-			d->timer->start(0);
-		} else {
-			qint64 currentTime = QDateTime::currentMSecsSinceEpoch() / 1000;
-			qint64 timeUntilNextCheck = d->checkInterval - (currentTime - d->lastUpdateCheck);
-			qint64 nextDueTime = (timeUntilNextCheck < 0) ? 0 : timeUntilNextCheck;
-
-			d->timer->start(nextDueTime * 1000);
-		}
-	}
-
-	d->settings->setValue(kIsFirstLaunch, false);
-
-	d->networkAccess = new QNetworkAccessManager(this);
-	connect(d->networkAccess, SIGNAL(finished(QNetworkReply *)), this, SLOT(appcastDownloaded(QNetworkReply *)));
+	// A zero timer only fires once the event loop has worked through what's queued at startup,
+	// reading the settings and arming the first check waits until then
+	QTimer::singleShot(0, this, SLOT(scheduleUpdateCheck()));
 
 	d->downloader = new QGlitterDownloader(this);
+	connect(d->downloader, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(updateDownloadProgress(qint64, qint64)));
+	connect(d->downloader, SIGNAL(downloadFinished(int, QString)), this, SLOT(updateDownloaded(int, QString)));
+
+	d->appcastParser = new QFutureWatcher<bool>(this);
+	connect(d->appcastParser, SIGNAL(finished()), this, SLOT(appcastParsed()));
 }
 
 QGlitterUpdater::~QGlitterUpdater()
 {
+	QGLITTER_D(QGlitterUpdater);
+
+	// The parser thread writes into d->appcast, don't pull it out from under it
+	d->appcastParser->waitForFinished();
 }
 
-const QPixmap *QGlitterUpdater::applicationIcon() const
+bool QGlitterUpdater::allowsVersionSkipping() const
 {
 	const QGLITTER_D(QGlitterUpdater);
-	return d->applicationIcon.data();
+	return d->allowVersionSkipping;
 }
 
-void QGlitterUpdater::setApplicationIcon(const QPixmap *icon)
+bool QGlitterUpdater::allowsDelayingInstallUntilQuit() const
 {
-	QGLITTER_D(QGlitterUpdater);
-	d->applicationIcon.reset(new QPixmap(*icon));
+	const QGLITTER_D(QGlitterUpdater);
+	return d->allowDelayInstallUntilQuit;
 }
 
 bool QGlitterUpdater::automaticallyCheckForUpdates() const
 {
 	const QGLITTER_D(QGlitterUpdater);
+	const_cast<QGlitterUpdaterPrivate *>(d)->loadSettings();
 	return d->automaticCheck;
 }
 
 void QGlitterUpdater::setAutomaticallyCheckForUpdates(bool automaticallyCheckForUpdates)
 {
 	QGLITTER_D(QGlitterUpdater);
+	d->loadSettings()->setValue(kAutomaticUpdateCheck, automaticallyCheckForUpdates);
 	d->automaticCheck = automaticallyCheckForUpdates;
-	d->settings->setValue(kAutomaticUpdateCheck, d->automaticCheck);
+	d->updatePushChannel();
 }
 
 bool QGlitterUpdater::automaticallyDownloadUpdates() const
 {
 	const QGLITTER_D(QGlitterUpdater);
+	const_cast<QGlitterUpdaterPrivate *>(d)->loadSettings();
 	return d->automaticDownload;
 }
 
 void QGlitterUpdater::setAutomaticallyDownloadUpdates(bool automaticallyDownloadUpdates)
 {
 	QGLITTER_D(QGlitterUpdater);
+	d->loadSettings()->setValue(kAutomaticDownload, automaticallyDownloadUpdates);
 	d->automaticDownload = automaticallyDownloadUpdates;
-	d->settings->setValue(kAutomaticDownload, d->automaticDownload);
+}
+
+bool QGlitterUpdater::speculativelyDownloadUpdates() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return d->speculativeDownload;
+}
+
+void QGlitterUpdater::setSpeculativelyDownloadUpdates(bool speculativelyDownloadUpdates)
+{
+	QGLITTER_D(QGlitterUpdater);
+	d->speculativeDownload = speculativelyDownloadUpdates;
+}
+
+QGlitterUpdater::DismissPolicy QGlitterUpdater::dismissPolicy() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return d->dismissPolicy;
+}
+
+void QGlitterUpdater::setDismissPolicy(DismissPolicy dismissPolicy)
+{
+	QGLITTER_D(QGlitterUpdater);
+	d->dismissPolicy = dismissPolicy;
 }
 
 int QGlitterUpdater::checkInterval() const
 {
 	const QGLITTER_D(QGlitterUpdater);
+	const_cast<QGlitterUpdaterPrivate *>(d)->loadSettings();
 	return d->checkInterval;
 }
 
@@ -179,14 +591,62 @@ void QGlitterUpdater::setCheckInterval(int checkInterval)
 		checkInterval = kOneHour;
 	}
 
+	d->loadSettings()->setValue(kCheckInterval, checkInterval);
 	d->checkInterval = checkInterval;
-	d->settings->setValue(kCheckInterval, d->checkInterval);
 
 	if (d->timer) {
 		d->timer->setInterval(d->checkInterval * 1000);
 	}
 }
 
+int QGlitterUpdater::checkJitter() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return d->checkJitter;
+}
+
+void QGlitterUpdater::setCheckJitter(int checkJitter)
+{
+	QGLITTER_D(QGlitterUpdater);
+	d->checkJitter = qMax(0, checkJitter);
+}
+
+bool QGlitterUpdater::coordinateProcesses() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return d->coordinateProcesses;
+}
+
+void QGlitterUpdater::setCoordinateProcesses(bool coordinateProcesses)
+{
+	QGLITTER_D(QGlitterUpdater);
+	d->coordinateProcesses = coordinateProcesses;
+}
+
+QGlitterRetryPolicy QGlitterUpdater::feedRetryPolicy() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return d->feedRetryPolicy;
+}
+
+void QGlitterUpdater::setFeedRetryPolicy(const QGlitterRetryPolicy &feedRetryPolicy)
+{
+	QGLITTER_D(QGlitterUpdater);
+	d->feedRetryPolicy = feedRetryPolicy;
+}
+
+QGlitterRetryPolicy QGlitterUpdater::downloadRetryPolicy() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return d->downloadRetryPolicy;
+}
+
+void QGlitterUpdater::setDownloadRetryPolicy(const QGlitterRetryPolicy &downloadRetryPolicy)
+{
+	QGLITTER_D(QGlitterUpdater);
+	d->downloadRetryPolicy = downloadRetryPolicy;
+}
+
 QString QGlitterUpdater::defaultLanguage() const
 {
 	const QGLITTER_D(QGlitterUpdater);
@@ -211,6 +671,74 @@ void QGlitterUpdater::setFeedUrl(QString feedUrl)
 	d->feedUrl = feedUrl;
 }
 
+QString QGlitterUpdater::pushUrl() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return d->pushUrl;
+}
+
+void QGlitterUpdater::setPushUrl(QString pushUrl)
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	if (d->pushUrl == pushUrl) {
+		return;
+	}
+
+	d->pushUrl = pushUrl;
+	d->updatePushChannel();
+}
+
+QNetworkAccessManager *QGlitterUpdater::networkAccessManager() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return const_cast<QGlitterUpdaterPrivate *>(d)->networkAccessManager();
+}
+
+QGlitterReleaseNotes *QGlitterUpdater::releaseNotes() const
+{
+	const QGLITTER_D(QGlitterUpdater);
+	return const_cast<QGlitterUpdaterPrivate *>(d)->releaseNotes();
+}
+
+void QGlitterUpdater::setNetworkAccessManager(QNetworkAccessManager *networkAccessManager)
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	if (d->networkAccess == networkAccessManager) {
+		return;
+	}
+
+	// Replies are children of their manager, ours is only let go once the last one is done
+	if (d->ownsNetworkAccess) {
+		connect(d->networkAccess, SIGNAL(finished(QNetworkReply *)), this, SLOT(retiredManagerFinished()));
+		if (!hasRunningReplies(d->networkAccess)) {
+			d->networkAccess->deleteLater();
+		}
+	}
+
+	d->networkAccess = networkAccessManager;
+	d->ownsNetworkAccess = false;
+
+	// Anything still pointing at the old manager would be left with nothing once it's deleted
+	d->downloader->setNetworkAccessManager(d->networkAccessManager());
+	if (d->releaseNotesFetcher) {
+		d->releaseNotesFetcher->setNetworkAccessManager(d->networkAccessManager());
+	}
+
+	// The push channel would otherwise stay on the old manager for as long as its stream lasts
+	d->updatePushChannel();
+}
+
+void QGlitterUpdater::retiredManagerFinished()
+{
+	QNetworkAccessManager *networkAccess = qobject_cast<QNetworkAccessManager *>(sender());
+	if (networkAccess && !hasRunningReplies(networkAccess)) {
+		networkAccess->disconnect(this);
+		networkAccess->deleteLater();
+	}
+}
+
 QString QGlitterUpdater::internalVersion() const
 {
 	const QGLITTER_D(QGlitterUpdater);
@@ -257,6 +785,8 @@ void QGlitterUpdater::checkForUpdates(const QGlitterAppcast &appcast)
 {
 	QGLITTER_D(QGlitterUpdater);
 
+	d->loadSettings();
+
 	QString currentVersion;
 	if (d->internalVersion.size()) {
 		currentVersion = d->internalVersion;
@@ -267,12 +797,19 @@ void QGlitterUpdater::checkForUpdates(const QGlitterAppcast &appcast)
 	QGlitterAppcastItem currentBestUpdate;
 	currentBestUpdate.setVersion(currentVersion);
 
+	QDateTime currentTime = QDateTime::currentDateTime();
+
 	QList<QGlitterAppcastItem> appcastItems = appcast.items();
 	for (int i = 0; i < appcastItems.size(); ++i) {
+		// Asking for updates explicitly gets past both skipped versions and phased rollouts
 		if (!d->isInteractive) {
 			if (d->ignoredVersions.indexOf(appcastItems[i].version()) >= 0) {
 				continue;
 			}
+
+			if (d->rolloutBucket >= appcastItems[i].rolloutPercentage(currentTime)) {
+				continue;
+			}
 		}
 
 		if (appcastItems[i].operatingSystem().length() > 0 && appcastItems[i].operatingSystem().compare(QGlitter::os(), Qt::CaseInsensitive) != 0) {
@@ -290,36 +827,21 @@ void QGlitterUpdater::checkForUpdates(const QGlitterAppcast &appcast)
 	}
 
 	if (compareVersions(currentBestUpdate.version(), currentVersion) > 0) {
-		emit foundUpdate(currentBestUpdate);
-
-		if (!d->automaticDownload) {
+		d->warmUpConnections(currentBestUpdate);
 
-			QGlitterUpdateAlert *updateAlert = new QGlitterUpdateAlert();
-
-			if (d->applicationIcon) {
-				updateAlert->setApplicationIcon(d->applicationIcon.data());
-			}
-			updateAlert->setAutomaticallyDownloadUpdates(d->automaticDownload);
-			updateAlert->setDefaultLanguage(d->defaultLanguage);
-			updateAlert->setAppcastItem(currentBestUpdate);
-			updateAlert->setAllowSkipping(d->allowVersionSkipping);
-
-			if (updateAlert->exec()) {
-				downloadAndInstall(kInteractiveDownload, currentBestUpdate);
-			}
-
-			if (updateAlert->skipVersion()) {
-				d->ignoredVersions.append(currentBestUpdate.version());
-				d->settings->setValue(kIgnoredVersions, d->ignoredVersions);
-			}
+		// Only the update alert shows release notes, fetching them now lets it show them straight away
+		QString releaseNotesUrl = QGlitterReleaseNotes::releaseNotesUrl(currentBestUpdate, d->defaultLanguage);
+		QByteArray cachedNotes;
+		if (!d->automaticDownload && releaseNotesUrl.size() && !d->releaseNotes()->cachedNotes(releaseNotesUrl, &cachedNotes)) {
+			d->releaseNotes()->fetch(releaseNotesUrl);
+		}
 
-			if (updateAlert->automaticallyDownloadUpdates()) {
-				setAutomaticallyDownloadUpdates(updateAlert->automaticallyDownloadUpdates());
-			}
+		emit foundUpdate(currentBestUpdate);
 
-			updateAlert->deleteLater();
-		} else {
-			downloadAndInstall(kBackgroundDownload, currentBestUpdate);
+		if (d->automaticDownload) {
+			downloadUpdate(currentBestUpdate);
+		} else if (d->speculativeDownload) {
+			d->startSpeculativeDownload(currentBestUpdate);
 		}
 	} else {
 		emit noUpdatesAvailable();
@@ -338,73 +860,209 @@ void QGlitterUpdater::aboutToQuit()
 	}
 }
 
-void QGlitterUpdater::automaticUpdateDownloaded(int errorCode, QString installerPath)
+void QGlitterUpdater::updateDownloaded(int errorCode, QString installerPath)
 {
 	QGLITTER_D(QGlitterUpdater);
 
-	if (errorCode != QGlitterDownloader::NoError) {
+	QSettings *settings = d->loadSettings();
+
+	d->isDownloading = false;
+
+	// The leader's installer was checked rather than downloaded, it counts for nothing in our bookkeeping
+	if (d->isVerifyingSharedInstaller) {
+		d->isVerifyingSharedInstaller = false;
+		d->retryItem = QGlitterAppcastItem();
+
+		if (errorCode != QGlitterDownloader::NoError) {
+			emit errorDownloadingUpdate(errorCode);
+			return;
+		}
+
+		d->sharedInstaller = installerPath;
+		emit finishedDownloadingUpdate(installerPath);
 		return;
 	}
 
-	// Disconnect in case this update is canceled and the next update is not automatic
-	disconnect(d->downloader, SIGNAL(downloadFinished(int, QString)), this, SLOT(automaticUpdateDownloaded(int, QString)));
+	// Nobody is waiting on it yet, downloadUpdate() reports it once the update is accepted.
+	// A failure is dropped quietly and the download starts over if the user asks for it.
+	if (d->isSpeculative) {
+		if (errorCode == QGlitterDownloader::NoError) {
+			d->speculativeInstaller = installerPath;
+		} else {
+			d->isSpeculative = false;
+			d->retryItem = QGlitterAppcastItem();
+		}
+		return;
+	}
 
-	// TODO: should probably allow for automatic installing as well
-	QGlitterAutomaticUpdateAlert *updateAlert = new QGlitterAutomaticUpdateAlert();
+	QGlitterCoordinator *coordinator = d->coordinator();
+	if (coordinator && coordinator->isLeader()) {
+		coordinator->publishInstaller(d->retryItem.url(), errorCode, installerPath);
+	}
 
-	if (d->applicationIcon) {
-		updateAlert->setApplicationIcon(d->applicationIcon.data());
+	if (errorCode != QGlitterDownloader::NoError) {
+		++d->downloadFailures;
+		d->lastDownloadFailure = QDateTime::currentMSecsSinceEpoch() / 1000;
+		settings->setValue(kDownloadFailures, d->downloadFailures);
+		settings->setValue(kLastDownloadFailure, d->lastDownloadFailure);
+
+		// Only downloads nobody asked for are retried behind the user's back
+		if (d->automaticDownload && !d->retryItem.url().isEmpty()) {
+			d->downloadRetryTimer->start(retryDelay(d->downloadRetryPolicy, d->downloadFailures) * 1000);
+		}
+
+		emit errorDownloadingUpdate(errorCode);
+		return;
 	}
-	updateAlert->setAllowSkipping(d->allowVersionSkipping);
-	updateAlert->setAllowDelaying(d->allowDelayInstallUntilQuit);
 
-	updateAlert->exec();
-	updateAlert->deleteLater();
+	d->downloadFailures = 0;
+	d->downloadedUrl = d->retryItem.url();
+	d->retryItem = QGlitterAppcastItem();
+	settings->setValue(kDownloadFailures, 0);
 
-	if (updateAlert->result() == QDialog::Rejected) {
-		emit updateCanceled();
-	} else {
-		if (d->allowDelayInstallUntilQuit && updateAlert->delayUntilQuit()) {
-			d->pendingUpdate = installerPath;
-		} else {
-			emit installingUpdate();
-			if (QGlitter::installUpdate(installerPath)) {
-				emit finishedInstallingUpdate();
-			}
-		}
+	emit finishedDownloadingUpdate(installerPath);
+}
+
+// Speculative downloads stay out of sight until the update is accepted
+void QGlitterUpdater::updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	if (!d->isSpeculative) {
+		emit downloadProgress(bytesReceived, bytesTotal);
 	}
 }
 
-void QGlitterUpdater::downloadAndInstall(int mode, const QGlitterAppcastItem &update)
+void QGlitterUpdater::retryDownload()
 {
 	QGLITTER_D(QGlitterUpdater);
 
-	d->downloader->downloadUpdate(update.url(), update.signature());
+	if (!d->retryItem.url().isEmpty()) {
+		downloadUpdate(d->retryItem);
+	}
+}
 
-	if (mode == kInteractiveDownload) {
-		QGlitterUpdateStatus *downloadStatus = new QGlitterUpdateStatus();
+void QGlitterUpdater::downloadUpdate(const QGlitterAppcastItem &appcastItem)
+{
+	QGLITTER_D(QGlitterUpdater);
 
-		if (d->applicationIcon) {
-			downloadStatus->setApplicationIcon(d->applicationIcon.data());
+	d->loadSettings();
+
+	// Already on its way, the rest of it comes at normal priority
+	if (d->isSpeculative && d->retryItem.url() == appcastItem.url()) {
+		d->isSpeculative = false;
+		d->downloader->setPriority(QNetworkRequest::NormalPriority);
+
+		if (d->speculativeInstaller.size()) {
+			QString installerPath = d->speculativeInstaller;
+			d->speculativeInstaller = "";
+			updateDownloaded(QGlitterDownloader::NoError, installerPath);
+		} else if (d->downloader->isPaused()) {
+			d->isDownloading = true;
+			d->downloader->setNetworkAccessManager(d->networkAccessManager());
+			d->downloader->resumeDownload();
 		}
+		return;
+	}
 
-		connect(d->downloader, SIGNAL(downloadProgress(qint64, qint64)), downloadStatus, SLOT(downloadProgress(qint64, qint64)));
-		connect(d->downloader, SIGNAL(downloadFinished(int, QString)), downloadStatus, SLOT(downloadFinished(int, QString)));
+	d->discardSpeculativeDownload();
+	d->downloader->setPriority(QNetworkRequest::NormalPriority);
 
-		downloadStatus->exec();
-		downloadStatus->deleteLater();
+	d->downloadRetryTimer->stop();
+	d->retryItem = appcastItem;
+	d->sharedInstaller = "";
 
-		if (downloadStatus->result() == QDialog::Rejected) {
-			d->downloader->cancelDownload();
-			emit updateCanceled();
-		} else if (d->downloader->errorCode() == QGlitterDownloader::NoError) {
-			emit installingUpdate();
-			if (QGlitter::installUpdate(d->downloader->installerFile())) {
-				emit finishedInstallingUpdate();
-			}
+	// The leader downloads it, sharedInstallerReceived() picks up from there
+	QGlitterCoordinator *coordinator = d->coordinator();
+	if (coordinator && coordinator->isFollower()) {
+		coordinator->requestDownload(appcastItem.url());
+		return;
+	}
+
+	if (isCircuitOpen(d->downloadRetryPolicy, d->downloadFailures, d->lastDownloadFailure)) {
+		if (coordinator && coordinator->isLeader()) {
+			coordinator->publishInstaller(appcastItem.url(), QGlitterDownloader::TooManyFailures, QString());
 		}
-	} else {
-		connect(d->downloader, SIGNAL(downloadFinished(int, QString)), this, SLOT(automaticUpdateDownloaded(int, QString)));
+
+		emit errorDownloadingUpdate(QGlitterDownloader::TooManyFailures);
+		return;
+	}
+
+	d->isDownloading = true;
+	d->downloader->setNetworkAccessManager(d->networkAccessManager());
+	d->downloader->downloadUpdate(appcastItem);
+}
+
+void QGlitterUpdater::installUpdate()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	QString installerPath = d->installerPath();
+	if (installerPath.isEmpty()) {
+		return;
+	}
+
+	emit installingUpdate();
+	if (QGlitter::installUpdate(installerPath)) {
+		emit finishedInstallingUpdate();
+	}
+}
+
+void QGlitterUpdater::installUpdateOnQuit()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	QString installerPath = d->installerPath();
+	if (installerPath.isEmpty()) {
+		return;
+	}
+
+	d->pendingUpdate = installerPath;
+}
+
+void QGlitterUpdater::skipVersion(const QString &version)
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	d->loadSettings();
+	if (d->ignoredVersions.indexOf(version) >= 0) {
+		return;
+	}
+
+	d->ignoredVersions.append(version);
+	d->settings->setValue(kIgnoredVersions, d->ignoredVersions);
+
+	if (d->isSpeculative && d->retryItem.version() == version) {
+		d->discardSpeculativeDownload();
+	}
+}
+
+void QGlitterUpdater::cancelUpdate()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	d->discardSpeculativeDownload();
+	d->downloader->cancelDownload();
+	d->isDownloading = false;
+	d->downloadRetryTimer->stop();
+	d->retryItem = QGlitterAppcastItem();
+	emit updateCanceled();
+}
+
+void QGlitterUpdater::dismissUpdate()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	if (!d->isSpeculative) {
+		return;
+	}
+
+	// A paused download keeps its partial file around for the next time the update is offered
+	if (d->dismissPolicy == DiscardDownload) {
+		d->discardSpeculativeDownload();
+	} else if (d->isDownloading) {
+		d->downloader->pauseDownload();
+		d->isDownloading = !d->downloader->isPaused();
 	}
 }
 
@@ -416,24 +1074,26 @@ void QGlitterUpdater::updateCheck()
 		return;
 	}
 
-	d->isInteractive = true;
-	d->isCheckingForUpdates = true;
-	QNetworkReply *reply = d->networkAccess->get(QNetworkRequest(QUrl(d->feedUrl)));
+	// While the breaker is open "check now" fails straight away instead of adding to the load
+	d->loadSettings();
+	if (isCircuitOpen(d->feedRetryPolicy, d->feedFailures, d->lastFeedFailure)) {
+		emit checkingForUpdates(true);
+		emit errorLoadingAppcast();
+		return;
+	}
 
-	QGlitterUpdateCheckStatus *updateCheckStatus = new QGlitterUpdateCheckStatus();
-	connect(this, SIGNAL(foundUpdate(const QGlitterAppcastItem &)), updateCheckStatus, SLOT(close()));
-	connect(this, SIGNAL(noUpdatesAvailable()), updateCheckStatus, SLOT(noUpdatesAvailable()));
-	connect(this, SIGNAL(errorLoadingAppcast()), updateCheckStatus, SLOT(noUpdatesAvailable()));
+	d->isInteractive = true;
 
-	updateCheckStatus->setNetworkReply(reply);
-	if (d->applicationIcon) {
-		updateCheckStatus->setApplicationIcon(d->applicationIcon.data());
+	// Ask the leader to check, the feed comes back through sharedAppcastReceived()
+	QGlitterCoordinator *coordinator = d->coordinator();
+	if (coordinator && coordinator->isFollower()) {
+		d->isCheckingForUpdates = true;
+		coordinator->requestCheck();
+		emit checkingForUpdates(true);
+		return;
 	}
 
-	updateCheckStatus->exec();
-	updateCheckStatus->deleteLater();
-
-	d->isInteractive = false;
+	startUpdateCheck();
 }
 
 void QGlitterUpdater::backgroundUpdateCheck()
@@ -441,29 +1101,150 @@ void QGlitterUpdater::backgroundUpdateCheck()
 	QTimer::singleShot(0, this, SLOT(updateTimeout()));
 }
 
-void QGlitterUpdater::appcastDownloaded(QNetworkReply *reply)
+void QGlitterUpdater::appcastDownloaded()
 {
 	QGLITTER_D(QGlitterUpdater);
 
-	if (reply->error() == QNetworkReply::NoError) {
-		QGlitterAppcast appcast;
+	QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+	if (!reply) {
+		return;
+	}
 
-		if (appcast.read(reply)) {
-			emit finishedLoadingAppcast(appcast);
-			checkForUpdates(appcast);
-		} else {
-			emit errorLoadingAppcast();
+	// Honoured for failures too, a 503 with Retry-After is exactly when it matters
+	d->serverMaxAge = maxAgeHint(reply);
+	d->serverRetryAfter = retryAfterHint(reply);
+
+	reply->deleteLater();
+
+	// The check whose feed is being parsed finishes this one as well
+	if (d->appcastParser->isRunning()) {
+		return;
+	}
+
+	QGlitterCoordinator *coordinator = d->coordinator();
+
+	if (reply->error() == QNetworkReply::NoError) {
+		QByteArray data = reply->readAll();
+		if (coordinator && coordinator->isLeader()) {
+			coordinator->publishAppcast(data);
 		}
+
+		// Parse on a worker thread, appcastParsed() continues on this one
+		d->parsingAppcast.reset(new QGlitterAppcast);
+		d->appcastParser->setFuture(QtConcurrent::run(readAppcast, d->parsingAppcast.data(), data));
 	} else {
+		if (coordinator && coordinator->isLeader()) {
+			coordinator->publishAppcastError();
+		}
+
 		qDebug() << "Network error:" << reply->errorString();
 		emit errorLoadingAppcast();
+
+		finishUpdateCheck(false);
 	}
+}
+
+void QGlitterUpdater::appcastParsed()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	bool success = d->appcastParser->result();
+	if (success) {
+		d->appcast.reset(d->parsingAppcast.take());
+		emit finishedLoadingAppcast(*d->appcast);
+		checkForUpdates(*d->appcast);
+	} else {
+		d->parsingAppcast.reset();
+		emit errorLoadingAppcast();
+	}
+
+	finishUpdateCheck(success);
+}
+
+void QGlitterUpdater::startUpdateCheck()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	d->isCheckingForUpdates = true;
+	d->serverMaxAge = 0;
+	d->serverRetryAfter = 0;
+
+	QNetworkReply *reply = d->networkAccessManager()->get(QNetworkRequest(QUrl(d->feedUrl)));
+	connect(reply, SIGNAL(finished()), this, SLOT(appcastDownloaded()));
+	connect(reply, SIGNAL(downloadProgress(qint64, qint64)), this, SIGNAL(appcastDownloadProgress(qint64, qint64)));
+
+	emit checkingForUpdates(d->isInteractive);
+}
+
+void QGlitterUpdater::finishUpdateCheck(bool success)
+{
+	QGLITTER_D(QGlitterUpdater);
 
 	d->isCheckingForUpdates = false;
+	d->isInteractive = false;
 	d->lastUpdateCheck = QDateTime::currentMSecsSinceEpoch() / 1000;
-	d->timer->setInterval(d->checkInterval * 1000);
 
-	reply->deleteLater();
+	// The leader already did the bookkeeping for the feed it passed on, doing it again here would
+	// count its failures once per process and overwrite its schedule
+	if (d->isSharedAppcast) {
+		d->isSharedAppcast = false;
+		return;
+	}
+
+	QSettings *settings = d->loadSettings();
+
+	// Failures are retried on the backoff schedule instead of waiting out a full interval
+	qint64 interval = 0;
+	if (success) {
+		d->feedFailures = 0;
+		interval = (d->serverMaxAge ? d->serverMaxAge : d->checkInterval) + randomUpTo(d->checkJitter);
+	} else {
+		++d->feedFailures;
+		d->lastFeedFailure = d->lastUpdateCheck;
+		settings->setValue(kLastFeedFailure, d->lastFeedFailure);
+		interval = retryDelay(d->feedRetryPolicy, d->feedFailures);
+	}
+
+	interval = qMax(interval, d->serverRetryAfter);
+	d->nextUpdateCheck = d->lastUpdateCheck + interval;
+
+	settings->setValue(kFeedFailures, d->feedFailures);
+	settings->setValue(kLastCheckTime, d->lastUpdateCheck);
+	settings->setValue(kNextCheckTime, d->nextUpdateCheck);
+
+	d->timer->start(interval * 1000);
+}
+
+void QGlitterUpdater::scheduleUpdateCheck()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	QSettings *settings = d->loadSettings();
+
+	// Settle who leads before the first check can come due
+	d->coordinator();
+
+	d->isScheduled = true;
+	d->updatePushChannel();
+
+	if (!settings->value(kIsFirstLaunch, true).toBool()) {
+		qint64 currentTime = QDateTime::currentMSecsSinceEpoch() / 1000;
+
+		// The next check time was jittered when it was stored, settings from older versions only have the last check
+		qint64 nextDueTime = 0;
+		if (d->nextUpdateCheck != kNeverUpdated) {
+			nextDueTime = d->nextUpdateCheck - currentTime;
+		} else if (d->lastUpdateCheck != kNeverUpdated) {
+			nextDueTime = d->checkInterval - (currentTime - d->lastUpdateCheck) + randomUpTo(d->checkJitter);
+		}
+
+		// Overdue checks still give the application a moment to settle after launch, and are spread
+		// out a little so a release announcement doesn't turn into a burst of simultaneous launches
+		qint64 startupDelay = kStartupCheckDelay + randomUpTo(qMin(d->checkJitter, kStartupJitter));
+		d->timer->start(qMax<qint64>(nextDueTime, startupDelay) * 1000);
+	}
+
+	settings->setValue(kIsFirstLaunch, false);
 }
 
 void QGlitterUpdater::updateTimeout()
@@ -474,7 +1255,138 @@ void QGlitterUpdater::updateTimeout()
 		return;
 	}
 
+	// Scheduled checks are the leader's job
+	QGlitterCoordinator *coordinator = d->coordinator();
+	if (coordinator && coordinator->isFollower()) {
+		return;
+	}
+
+	d->loadSettings();
+	if (isCircuitOpen(d->feedRetryPolicy, d->feedFailures, d->lastFeedFailure)) {
+		qint64 currentTime = QDateTime::currentMSecsSinceEpoch() / 1000;
+		d->timer->start((d->lastFeedFailure + d->feedRetryPolicy.circuitBreakerDuration() - currentTime) * 1000);
+		return;
+	}
+
+	startUpdateCheck();
+}
+
+void QGlitterUpdater::followerCheckRequested()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	// A check already underway will be published when it's done
+	if (d->isCheckingForUpdates) {
+		return;
+	}
+
+	d->loadSettings();
+	if (isCircuitOpen(d->feedRetryPolicy, d->feedFailures, d->lastFeedFailure)) {
+		d->coordinator()->publishAppcastError();
+		return;
+	}
+
+	startUpdateCheck();
+}
+
+void QGlitterUpdater::followerDownloadRequested(const QString &url)
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	if (d->downloadedUrl == url && !d->installerPath().isEmpty()) {
+		d->coordinator()->publishInstaller(url, QGlitterDownloader::NoError, d->installerPath());
+		return;
+	}
+
+	if (d->isDownloading && !d->isSpeculative && d->retryItem.url() == url) {
+		return;
+	}
+
+	// Only items from the feed we fetched ourselves, followers don't get to pick arbitrary urls
+	if (d->appcast) {
+		foreach (const QGlitterAppcastItem &item, d->appcast->items()) {
+			if (item.url() == url) {
+				downloadUpdate(item);
+				return;
+			}
+		}
+	}
+
+	d->coordinator()->publishInstaller(url, QGlitterDownloader::UnspecifiedError, QString());
+}
+
+// Every client hears the announcement at once, spread the checks over a few seconds
+void QGlitterUpdater::releaseAnnounced()
+{
+	QTimer::singleShot(randomUpTo(kAnnouncementJitter) * 1000, this, SLOT(updateTimeout()));
+}
+
+// A follower that takes over from a leader that went away has to start listening itself
+void QGlitterUpdater::roleChanged()
+{
+	QGLITTER_D(QGlitterUpdater);
+	d->updatePushChannel();
+}
+
+// Whatever was asked of the old leader won't be answered, fail it so the application can ask again
+void QGlitterUpdater::leaderLost()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	if (!d->appcastParser->isRunning()) {
+		sharedAppcastFailed();
+	}
+
+	if (!d->isDownloading && !d->retryItem.url().isEmpty()) {
+		d->retryItem = QGlitterAppcastItem();
+		emit errorDownloadingUpdate(QGlitterDownloader::UnspecifiedError);
+	}
+}
+
+void QGlitterUpdater::sharedAppcastReceived(const QByteArray &data)
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	if (d->appcastParser->isRunning()) {
+		return;
+	}
+
 	d->isCheckingForUpdates = true;
-	d->networkAccess->get(QNetworkRequest(QUrl(d->feedUrl)));
+	d->isSharedAppcast = true;
+	d->serverMaxAge = 0;
+	d->serverRetryAfter = 0;
+
+	d->parsingAppcast.reset(new QGlitterAppcast);
+	d->appcastParser->setFuture(QtConcurrent::run(readAppcast, d->parsingAppcast.data(), data));
 }
 
+void QGlitterUpdater::sharedAppcastFailed()
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	// The leader keeps the failure count, there's nothing to reschedule here
+	if (d->isCheckingForUpdates) {
+		d->isCheckingForUpdates = false;
+		d->isInteractive = false;
+		emit errorLoadingAppcast();
+	}
+}
+
+void QGlitterUpdater::sharedInstallerReceived(const QString &url, int errorCode, const QString &installerPath)
+{
+	QGLITTER_D(QGlitterUpdater);
+
+	if (url.isEmpty() || url != d->retryItem.url()) {
+		return;
+	}
+
+	if (errorCode != QGlitterDownloader::NoError) {
+		d->retryItem = QGlitterAppcastItem();
+		emit errorDownloadingUpdate(errorCode);
+		return;
+	}
+
+	// Anyone able to bind the socket name could be talking to us, trust the signature rather than the sender
+	d->isVerifyingSharedInstaller = true;
+	d->downloader->verifySharedInstaller(d->retryItem, installerPath);
+}
@@ -22,13 +22,14 @@
 
 #include "QGlitterObject.h"
 #include "QGlitterConfig.h"
+#include "QGlitterRetryPolicy.h"
 
 #include <QObject>
 
 class QGlitterAppcast;
 class QGlitterAppcastItem;
-class QNetworkReply;
-class QPixmap;
+class QGlitterReleaseNotes;
+class QNetworkAccessManager;
 
 typedef int (*VersionComparator)(const QString &, const QString &);
 
@@ -37,11 +38,18 @@ class QGLITTER_EXPORTED QGlitterUpdater : public QObject, public QGlitterObject
 {
 	Q_OBJECT
 public:
+	// What dismissing the update alert does to a speculative download
+	enum DismissPolicy
+	{
+		PauseDownload,
+		DiscardDownload,
+	};
+
 	QGlitterUpdater(bool allowVersionSkipping = true, bool allowDelayInstalUntilQuit = true, int checkInterval = 0, QObject *parent = 0);
 	~QGlitterUpdater();
 
-	const QPixmap *applicationIcon() const;
-	void setApplicationIcon(const QPixmap *icon);
+	bool allowsVersionSkipping() const;
+	bool allowsDelayingInstallUntilQuit() const;
 
 	bool automaticallyCheckForUpdates() const;
 	void setAutomaticallyCheckForUpdates(bool automaticallyCheckForUpdates);
@@ -49,15 +57,55 @@ public:
 	bool automaticallyDownloadUpdates() const;
 	void setAutomaticallyDownloadUpdates(bool automaticallyDownloadUpdates);
 
+	// Without automatic downloads a found update is still fetched at low priority while the
+	// user makes up their mind, so accepting it doesn't leave them watching a progress bar
+	bool speculativelyDownloadUpdates() const;
+	void setSpeculativelyDownloadUpdates(bool speculativelyDownloadUpdates);
+
+	DismissPolicy dismissPolicy() const;
+	void setDismissPolicy(DismissPolicy dismissPolicy);
+
 	int checkInterval() const;
 	void setCheckInterval(int checkInterval);
 
+	// Scheduled checks are pushed back by a random delay of up to checkJitter seconds so
+	// installations don't all hit the feed at the same moment
+	int checkJitter() const;
+	void setCheckJitter(int checkJitter);
+
+	// Processes of the same application and user elect one of themselves to fetch the feed and
+	// download installers, the others are handed its results instead of going to the network
+	bool coordinateProcesses() const;
+	void setCoordinateProcesses(bool coordinateProcesses);
+
+	// Failed feed fetches and automatic downloads are retried according to these, the
+	// failure counts behind them are kept in the settings across launches
+	QGlitterRetryPolicy feedRetryPolicy() const;
+	void setFeedRetryPolicy(const QGlitterRetryPolicy &feedRetryPolicy);
+
+	QGlitterRetryPolicy downloadRetryPolicy() const;
+	void setDownloadRetryPolicy(const QGlitterRetryPolicy &downloadRetryPolicy);
+
 	QString defaultLanguage() const;
 	void setDefaultLanguage(QString language);
 
 	QString feedUrl() const;
 	void setFeedUrl(QString feedUrl);
 
+	// Optional Server-Sent Events stream announcing new releases, a "release" event on it
+	// triggers a background check right away. Polling on checkInterval carries on as a fallback.
+	QString pushUrl() const;
+	void setPushUrl(QString pushUrl);
+
+	// Feed, release notes and downloads all share this manager so their connections get reused.
+	// The updater creates its own unless the application hands in one it already has.
+	QNetworkAccessManager *networkAccessManager() const;
+	void setNetworkAccessManager(QNetworkAccessManager *networkAccessManager);
+
+	// Release notes of a found update are fetched before foundUpdate() is emitted, the update
+	// alert picks them up from here
+	QGlitterReleaseNotes *releaseNotes() const;
+
 	QString internalVersion() const;
 	void setInternalVersion(QString internalVersion);
 
@@ -67,7 +115,12 @@ public:
 	void setVersionComparator(VersionComparator comparator);
 
 signals:
+	void appcastDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	void checkingForUpdates(bool interactive);
+	void downloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+	void errorDownloadingUpdate(int errorCode);
 	void errorLoadingAppcast();
+	void finishedDownloadingUpdate(const QString &installerPath);
 	void finishedInstallingUpdate();
 	void finishedLoadingAppcast(const QGlitterAppcast &appcast);
 	void foundUpdate(const QGlitterAppcastItem &appcastItem);
@@ -79,16 +132,40 @@ public slots:
 	void backgroundUpdateCheck();
 	void updateCheck();
 
+	// Every step below returns immediately, progress and results arrive through the signals above
+	void downloadUpdate(const QGlitterAppcastItem &appcastItem);
+	void installUpdate();
+	void installUpdateOnQuit();
+	void skipVersion(const QString &version);
+	void cancelUpdate();
+
+	// The user turned the update down for now, see dismissPolicy()
+	void dismissUpdate();
+
 private slots:
 	void aboutToQuit();
-	void automaticUpdateDownloaded(int errorCode, QString installerPath);
-	void appcastDownloaded(QNetworkReply *reply);
+	void appcastDownloaded();
+	void appcastParsed();
+	void followerCheckRequested();
+	void followerDownloadRequested(const QString &url);
+	void leaderLost();
+	void releaseAnnounced();
+	void retiredManagerFinished();
+	void retryDownload();
+	void roleChanged();
+	void scheduleUpdateCheck();
+	void sharedAppcastFailed();
+	void sharedAppcastReceived(const QByteArray &data);
+	void sharedInstallerReceived(const QString &url, int errorCode, const QString &installerPath);
+	void updateDownloaded(int errorCode, QString installerPath);
+	void updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
 	void updateTimeout();
 
 private:
 	void checkForUpdates(const QGlitterAppcast &appcast);
 	int compareVersions(const QString &lhs, const QString &rhs) const;
-	void downloadAndInstall(int mode, const QGlitterAppcastItem &update);
+	void finishUpdateCheck(bool success);
+	void startUpdateCheck();
 
 	QGLITTER_DECLARE_PRIVATE(QGlitterUpdater);
 	QGLITTER_DISABLE_COPY(QGlitterUpdater);
@@ -0,0 +1,224 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "QGlitterUpdaterDialogs.h"
+#include "QGlitterUpdaterDialogs_p.h"
+#include "QGlitterAutomaticUpdateAlert.h"
+#include "QGlitterDownloader.h"
+#include "QGlitterUpdateAlert.h"
+#include "QGlitterUpdateCheckStatus.h"
+#include "QGlitterUpdateStatus.h"
+#include "QGlitterUpdater.h"
+
+#include <QPixmap>
+
+QGlitterUpdaterDialogsPrivate::QGlitterUpdaterDialogsPrivate()
+	: applicationIcon(0)
+	, updater(0)
+	, update()
+	, updateCheckStatus(0)
+	, updateStatus(0)
+{
+}
+
+QGlitterUpdaterDialogs::QGlitterUpdaterDialogs(QGlitterUpdater *updater)
+	: QObject(updater)
+	, QGlitterObject(new QGlitterUpdaterDialogsPrivate)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	d->updater = updater;
+
+	connect(updater, SIGNAL(checkingForUpdates(bool)), this, SLOT(checkingForUpdates(bool)));
+	connect(updater, SIGNAL(foundUpdate(const QGlitterAppcastItem &)), this, SLOT(foundUpdate(const QGlitterAppcastItem &)));
+	connect(updater, SIGNAL(finishedDownloadingUpdate(const QString &)), this, SLOT(finishedDownloadingUpdate(const QString &)));
+	connect(updater, SIGNAL(errorDownloadingUpdate(int)), this, SLOT(errorDownloadingUpdate(int)));
+}
+
+QGlitterUpdaterDialogs::~QGlitterUpdaterDialogs()
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	delete d->updateCheckStatus;
+	delete d->updateStatus;
+}
+
+const QPixmap *QGlitterUpdaterDialogs::applicationIcon() const
+{
+	const QGLITTER_D(QGlitterUpdaterDialogs);
+	return d->applicationIcon.data();
+}
+
+void QGlitterUpdaterDialogs::setApplicationIcon(const QPixmap *icon)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+	d->applicationIcon.reset(new QPixmap(*icon));
+}
+
+void QGlitterUpdaterDialogs::checkingForUpdates(bool interactive)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	if (!interactive || d->updateCheckStatus) {
+		return;
+	}
+
+	d->updateCheckStatus = new QGlitterUpdateCheckStatus();
+	d->updateCheckStatus->setAttribute(Qt::WA_DeleteOnClose);
+
+	connect(d->updater, SIGNAL(appcastDownloadProgress(qint64, qint64)), d->updateCheckStatus, SLOT(downloadProgress(qint64, qint64)));
+	connect(d->updater, SIGNAL(noUpdatesAvailable()), d->updateCheckStatus, SLOT(noUpdatesAvailable()));
+	connect(d->updater, SIGNAL(errorLoadingAppcast()), d->updateCheckStatus, SLOT(noUpdatesAvailable()));
+
+	if (d->applicationIcon) {
+		d->updateCheckStatus->setApplicationIcon(d->applicationIcon.data());
+	}
+
+	d->updateCheckStatus->open();
+}
+
+void QGlitterUpdaterDialogs::foundUpdate(const QGlitterAppcastItem &appcastItem)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	if (d->updateCheckStatus) {
+		d->updateCheckStatus->close();
+	}
+
+	// The updater fetches the update on its own, automaticUpdateAlert takes over once it's there
+	if (d->updater->automaticallyDownloadUpdates()) {
+		return;
+	}
+
+	d->update = appcastItem;
+
+	QGlitterUpdateAlert *updateAlert = new QGlitterUpdateAlert();
+	updateAlert->setAttribute(Qt::WA_DeleteOnClose);
+
+	if (d->applicationIcon) {
+		updateAlert->setApplicationIcon(d->applicationIcon.data());
+	}
+	updateAlert->setAutomaticallyDownloadUpdates(d->updater->automaticallyDownloadUpdates());
+	updateAlert->setDefaultLanguage(d->updater->defaultLanguage());
+	updateAlert->setReleaseNotes(d->updater->releaseNotes());
+	updateAlert->setAppcastItem(appcastItem);
+	updateAlert->setAllowSkipping(d->updater->allowsVersionSkipping());
+
+	connect(updateAlert, SIGNAL(finished(int)), this, SLOT(updateAlertFinished(int)));
+	updateAlert->open();
+}
+
+void QGlitterUpdaterDialogs::updateAlertFinished(int result)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	QGlitterUpdateAlert *updateAlert = qobject_cast<QGlitterUpdateAlert *>(sender());
+	if (!updateAlert) {
+		return;
+	}
+
+	if (result == QDialog::Accepted) {
+		d->updateStatus = new QGlitterUpdateStatus();
+		d->updateStatus->setAttribute(Qt::WA_DeleteOnClose);
+
+		if (d->applicationIcon) {
+			d->updateStatus->setApplicationIcon(d->applicationIcon.data());
+		}
+
+		connect(d->updater, SIGNAL(downloadProgress(qint64, qint64)), d->updateStatus, SLOT(downloadProgress(qint64, qint64)));
+		connect(d->updateStatus, SIGNAL(finished(int)), this, SLOT(updateStatusFinished(int)));
+
+		d->updater->downloadUpdate(d->update);
+		d->updateStatus->open();
+	} else {
+		d->updater->dismissUpdate();
+	}
+
+	if (updateAlert->skipVersion()) {
+		d->updater->skipVersion(d->update.version());
+	}
+
+	if (updateAlert->automaticallyDownloadUpdates()) {
+		d->updater->setAutomaticallyDownloadUpdates(updateAlert->automaticallyDownloadUpdates());
+	}
+}
+
+void QGlitterUpdaterDialogs::updateStatusFinished(int result)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	d->updateStatus = 0;
+
+	if (result == QDialog::Rejected) {
+		d->updater->cancelUpdate();
+	} else {
+		d->updater->installUpdate();
+	}
+}
+
+void QGlitterUpdaterDialogs::finishedDownloadingUpdate(const QString &installerPath)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	if (d->updateStatus) {
+		d->updateStatus->downloadFinished(QGlitterDownloader::NoError, installerPath);
+		return;
+	}
+
+	// TODO: should probably allow for automatic installing as well
+	QGlitterAutomaticUpdateAlert *updateAlert = new QGlitterAutomaticUpdateAlert();
+	updateAlert->setAttribute(Qt::WA_DeleteOnClose);
+
+	if (d->applicationIcon) {
+		updateAlert->setApplicationIcon(d->applicationIcon.data());
+	}
+	updateAlert->setAllowSkipping(d->updater->allowsVersionSkipping());
+	updateAlert->setAllowDelaying(d->updater->allowsDelayingInstallUntilQuit());
+
+	connect(updateAlert, SIGNAL(finished(int)), this, SLOT(automaticUpdateAlertFinished(int)));
+	updateAlert->open();
+}
+
+void QGlitterUpdaterDialogs::errorDownloadingUpdate(int errorCode)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	if (d->updateStatus) {
+		d->updateStatus->downloadFinished(errorCode, "");
+	}
+}
+
+void QGlitterUpdaterDialogs::automaticUpdateAlertFinished(int result)
+{
+	QGLITTER_D(QGlitterUpdaterDialogs);
+
+	QGlitterAutomaticUpdateAlert *updateAlert = qobject_cast<QGlitterAutomaticUpdateAlert *>(sender());
+	if (!updateAlert) {
+		return;
+	}
+
+	if (result == QDialog::Rejected) {
+		d->updater->cancelUpdate();
+	} else if (d->updater->allowsDelayingInstallUntilQuit() && updateAlert->delayUntilQuit()) {
+		d->updater->installUpdateOnQuit();
+	} else {
+		d->updater->installUpdate();
+	}
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "QGlitterObject.h"
+#include "QGlitterConfig.h"
+
+#include <QObject>
+
+class QGlitterAppcastItem;
+class QGlitterUpdater;
+class QPixmap;
+
+// Drives the bundled update dialogs from the signals of a QGlitterUpdater.
+// Applications that present updates themselves simply don't create one.
+class QGlitterUpdaterDialogsPrivate;
+class QGLITTER_WIDGETS_EXPORTED QGlitterUpdaterDialogs : public QObject, public QGlitterObject
+{
+	Q_OBJECT
+public:
+	QGlitterUpdaterDialogs(QGlitterUpdater *updater);
+	~QGlitterUpdaterDialogs();
+
+	const QPixmap *applicationIcon() const;
+	void setApplicationIcon(const QPixmap *icon);
+
+private slots:
+	void automaticUpdateAlertFinished(int result);
+	void checkingForUpdates(bool interactive);
+	void errorDownloadingUpdate(int errorCode);
+	void finishedDownloadingUpdate(const QString &installerPath);
+	void foundUpdate(const QGlitterAppcastItem &appcastItem);
+	void updateAlertFinished(int result);
+	void updateStatusFinished(int result);
+
+private:
+	QGLITTER_DECLARE_PRIVATE(QGlitterUpdaterDialogs);
+	QGLITTER_DISABLE_COPY(QGlitterUpdaterDialogs);
+};
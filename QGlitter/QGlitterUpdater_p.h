@@ -21,12 +21,18 @@
 #pragma once
 
 #include "QGlitterUpdater.h"
+#include "QGlitterAppcastItem.h"
 #include "QGlitterObject.h"
+#include "QGlitterRetryPolicy.h"
 
 #include <QStringList>
 
+class QGlitterAppcast;
+class QGlitterCoordinator;
+class QGlitterPushChannel;
+class QGlitterReleaseNotes;
+template <typename T> class QFutureWatcher;
 class QNetworkAccessManager;
-class QPixmap;
 class QSettings;
 class QGlitterDownloader;
 class QTimer;
@@ -37,27 +43,82 @@ class QGlitterUpdaterPrivate : public QGlitterObjectData
 public:
 	QGlitterUpdaterPrivate();
 
-	QScopedPointer<QPixmap> applicationIcon;
+	// Both are created on first use so constructing an updater stays cheap
+	QNetworkAccessManager *networkAccessManager();
+	QGlitterReleaseNotes *releaseNotes();
+	QSettings *loadSettings();
+
+	// Null unless coordinateProcesses is set
+	QGlitterCoordinator *coordinator();
+	QString installerPath() const;
+	QString cacheDirectory() const;
+	QString settingsDomain() const;
+	void updatePushChannel();
+
+	void startSpeculativeDownload(const QGlitterAppcastItem &appcastItem);
+	void warmUpConnections(const QGlitterAppcastItem &appcastItem);
+	void discardSpeculativeDownload();
+
 	QString internalVersion;
 	QByteArray publicKey;
 
 	bool automaticCheck;
 	bool automaticDownload;
+	bool speculativeDownload;
+	QGlitterUpdater::DismissPolicy dismissPolicy;
 	int checkInterval;
+	int checkJitter;
 	QString defaultLanguage;
 	QString feedUrl;
+	QString pushUrl;
 	QStringList ignoredVersions;
+	int rolloutBucket;
 
 	bool allowVersionSkipping;
 	bool allowDelayInstallUntilQuit;
 	bool isCheckingForUpdates;
 	bool isInteractive;
 	qint64 lastUpdateCheck;
+	qint64 nextUpdateCheck;
+	qint64 serverMaxAge;
+	qint64 serverRetryAfter;
+
+	QGlitterRetryPolicy feedRetryPolicy;
+	int feedFailures;
+	qint64 lastFeedFailure;
+
+	QGlitterRetryPolicy downloadRetryPolicy;
+	int downloadFailures;
+	qint64 lastDownloadFailure;
+	QGlitterAppcastItem retryItem;
+	QTimer *downloadRetryTimer;
 	QNetworkAccessManager *networkAccess;
+	bool ownsNetworkAccess;
+	QGlitterReleaseNotes *releaseNotesFetcher;
 	QSettings *settings;
 	QTimer *timer;
 	QGlitterDownloader *downloader;
+	QScopedPointer<QGlitterAppcast> appcast;
+
+	// Only the parser thread touches it until appcastParsed() moves it into appcast
+	QScopedPointer<QGlitterAppcast> parsingAppcast;
+	QFutureWatcher<bool> *appcastParser;
 	QString pendingUpdate;
 
+	// Set while the current download hasn't been asked for yet
+	bool isSpeculative;
+	QString speculativeInstaller;
+
+	bool coordinateProcesses;
+	QGlitterCoordinator *processCoordinator;
+	bool isDownloading;
+	QString downloadedUrl;
+	QString sharedInstaller;
+	bool isVerifyingSharedInstaller;
+	bool isSharedAppcast;
+
+	QGlitterPushChannel *pushChannel;
+	bool isScheduled;
+
 	VersionComparator versionComparator;
 };
@@ -0,0 +1,288 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "Agent.h"
+#include "Common.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QLocalServer>
+
+#include <iostream>
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+static const int kMaxRequestLength = 1024;
+static const int kAgentTimeout = 30000;
+
+#ifdef Q_OS_UNIX
+static int s_terminationPipe[2] = { -1, -1 };
+
+// Only async-signal-safe calls are allowed here, the event loop reads the byte and quits
+static void terminationHandler(int)
+{
+	char byte = 1;
+	ssize_t written = write(s_terminationPipe[1], &byte, 1);
+	(void)written;
+}
+
+// An agent is usually stopped with a signal, leaving through the event loop lets it remove its socket
+static void quitOnTermination(QCoreApplication *application)
+{
+	if (pipe(s_terminationPipe) != 0) {
+		return;
+	}
+
+	QSocketNotifier *notifier = new QSocketNotifier(s_terminationPipe[0], QSocketNotifier::Read, application);
+	QObject::connect(notifier, SIGNAL(activated(int)), application, SLOT(quit()));
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = terminationHandler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+
+	sigaction(SIGTERM, &action, 0);
+	sigaction(SIGINT, &action, 0);
+	sigaction(SIGHUP, &action, 0);
+}
+#endif
+
+SigningAgent::SigningAgent(const QGlitterPrivateKey &privateKey, QObject *parent)
+	: QObject(parent)
+	, m_privateKey(privateKey)
+	, m_server(new QLocalServer(this))
+{
+	connect(m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+bool SigningAgent::listen(const QString &socketName)
+{
+	// A socket left behind by an agent that didn't shut down cleanly would block listen()
+	QLocalServer::removeServer(socketName);
+
+#if QT_VERSION >= 0x050000
+	m_server->setSocketOptions(QLocalServer::UserAccessOption);
+#endif
+
+	return m_server->listen(socketName);
+}
+
+QString SigningAgent::errorString() const
+{
+	return m_server->errorString();
+}
+
+QString SigningAgent::serverName() const
+{
+	return m_server->fullServerName();
+}
+
+void SigningAgent::newConnection()
+{
+	while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+		connect(socket, SIGNAL(readyRead()), this, SLOT(readyRead()));
+		connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+	}
+}
+
+void SigningAgent::readyRead()
+{
+	QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+	if (!socket) {
+		return;
+	}
+
+	while (socket->canReadLine()) {
+		QByteArray reply = handleRequest(socket->readLine().trimmed());
+		socket->write(reply + "\n");
+	}
+
+	if (socket->bytesAvailable() > kMaxRequestLength) {
+		socket->disconnectFromServer();
+	}
+}
+
+QByteArray SigningAgent::handleRequest(const QByteArray &request)
+{
+	if (request == "ALGORITHM") {
+		return "OK " + QGlitter::signatureAlgorithmName(m_privateKey.algorithm()).toLatin1();
+	}
+
+	if (request.startsWith("SIGN ")) {
+		QByteArray digest = QByteArray::fromHex(request.mid(5));
+		if (digest.size() != 20 && digest.size() != 32) {
+			return "ERR Invalid digest";
+		}
+
+		QGlitter::CryptoResult result = QGlitter::signDigest(digest, m_privateKey);
+		if (!result.success) {
+			return "ERR " + result.errorMessage.simplified().toUtf8();
+		}
+
+		return "OK " + result.signature.toBase64();
+	}
+
+	return "ERR Unknown request";
+}
+
+bool AgentConnection::connectToAgent(const QString &socketName)
+{
+	m_socket.connectToServer(socketName);
+	if (!m_socket.waitForConnected(kAgentTimeout)) {
+		m_errorString = "Unable to connect to agent " + socketName + ": " + m_socket.errorString();
+		return false;
+	}
+
+	return true;
+}
+
+QGlitter::SignatureAlgorithm AgentConnection::algorithm()
+{
+	QByteArray reply;
+	if (!request("ALGORITHM", &reply)) {
+		return QGlitter::UnknownSignatureAlgorithm;
+	}
+
+	return QGlitter::signatureAlgorithmFromName(QString::fromLatin1(reply));
+}
+
+QGlitter::CryptoResult AgentConnection::sign(const QByteArray &digest)
+{
+	QGlitter::CryptoResult result;
+	result.digest = digest;
+
+	QByteArray reply;
+	if (request("SIGN " + digest.toHex(), &reply)) {
+		result.signature = QByteArray::fromBase64(reply);
+		result.success = !result.signature.isEmpty();
+	} else {
+		result.errorMessage = m_errorString;
+	}
+
+	return result;
+}
+
+QString AgentConnection::errorString() const
+{
+	return m_errorString;
+}
+
+bool AgentConnection::request(const QByteArray &line, QByteArray *reply)
+{
+	m_socket.write(line + "\n");
+	if (!m_socket.waitForBytesWritten(kAgentTimeout)) {
+		m_errorString = "Unable to reach agent: " + m_socket.errorString();
+		return false;
+	}
+
+	while (!m_socket.canReadLine()) {
+		if (!m_socket.waitForReadyRead(kAgentTimeout)) {
+			m_errorString = "No reply from agent: " + m_socket.errorString();
+			return false;
+		}
+	}
+
+	QByteArray response = m_socket.readLine().trimmed();
+	if (!response.startsWith("OK ")) {
+		m_errorString = "Agent: " + QString::fromUtf8(response.startsWith("ERR ") ? response.mid(4) : response);
+		return false;
+	}
+
+	*reply = response.mid(3);
+
+	return true;
+}
+
+void printAgentUsage()
+{
+	std::cerr << "    qglitter-tool agent [--socket <name>] [--passphrase-env <variable>] <keyfile>" << std::endl;
+}
+
+int runAgent(QStringList arguments)
+{
+	QString socketName = "";
+	takeOption(arguments, "--socket", &socketName);
+
+	QString passphraseVariable = "";
+	takeOption(arguments, "--passphrase-env", &passphraseVariable);
+
+	if (arguments.size() != 1) {
+		printAgentUsage();
+		return -1;
+	}
+
+	QByteArray keyData;
+	if (!readKeyFile(arguments.first(), &keyData)) {
+		return -1;
+	}
+
+	// The passphrase never appears on a command line, it comes from the environment or stdin
+	QGlitterPrivateKey privateKey(keyData, readPassphrase(passphraseVariable, keyData));
+	if (!privateKey.isValid()) {
+		std::cerr << "ERROR: " << QGlitter::errorMessage().toStdString() << std::endl;
+		return -1;
+	}
+
+	int argc = 1;
+	char applicationName[] = "qglitter-tool";
+	char *argv[] = { applicationName, 0 };
+	QCoreApplication application(argc, argv);
+
+#ifdef Q_OS_UNIX
+	quitOnTermination(&application);
+#endif
+
+	// Without an explicit name the socket goes in a directory only this user can enter
+	QString socketDirectory;
+	if (socketName.isEmpty()) {
+		socketDirectory = QDir::temp().absoluteFilePath(QString("qglitter-agent-%1").arg(QCoreApplication::applicationPid()));
+		if (!QDir().mkpath(socketDirectory) || !QFile::setPermissions(socketDirectory, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner)) {
+			std::cerr << "Unable to create " << socketDirectory.toStdString() << std::endl;
+			return -1;
+		}
+
+		socketName = QDir(socketDirectory).absoluteFilePath("agent.sock");
+	}
+
+	SigningAgent agent(privateKey);
+	if (!agent.listen(socketName)) {
+		std::cerr << "Unable to listen on " << socketName.toStdString() << ": " << agent.errorString().toStdString() << std::endl;
+		return -1;
+	}
+
+	std::cout << "QGLITTER_AGENT_SOCKET=" << agent.serverName().toStdString() << std::endl;
+
+	int result = application.exec();
+
+	if (socketDirectory.size()) {
+		QLocalServer::removeServer(socketName);
+		QDir().rmdir(socketDirectory);
+	}
+
+	return result;
+}
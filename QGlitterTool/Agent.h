@@ -0,0 +1,78 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "QGlitter/Crypto/Crypto.h"
+
+#include <QByteArray>
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class QLocalServer;
+
+// Holds an unlocked private key and signs digests sent over a local socket.
+// Requests and replies are single lines:
+//   ALGORITHM         -> OK <algorithm name>
+//   SIGN <hex digest> -> OK <signature, as 'sign' prints it>
+// Failures are answered with ERR <message>.
+class SigningAgent : public QObject
+{
+	Q_OBJECT
+public:
+	SigningAgent(const QGlitterPrivateKey &privateKey, QObject *parent = 0);
+
+	bool listen(const QString &socketName);
+	QString errorString() const;
+	QString serverName() const;
+
+private slots:
+	void newConnection();
+	void readyRead();
+
+private:
+	QByteArray handleRequest(const QByteArray &request);
+
+	QGlitterPrivateKey m_privateKey;
+	QLocalServer *m_server;
+};
+
+// Blocking client side of the agent protocol
+class AgentConnection
+{
+public:
+	bool connectToAgent(const QString &socketName);
+
+	QGlitter::SignatureAlgorithm algorithm();
+	QGlitter::CryptoResult sign(const QByteArray &digest);
+
+	QString errorString() const;
+
+private:
+	bool request(const QByteArray &line, QByteArray *reply);
+
+	QLocalSocket m_socket;
+	QString m_errorString;
+};
+
+void printAgentUsage();
+int runAgent(QStringList arguments);
@@ -0,0 +1,457 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "Bench.h"
+#include "Common.h"
+#include "QGlitter/QGlitterAppcast.h"
+#include "QGlitter/Crypto/Crypto.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QTemporaryFile>
+#include <QXmlStreamWriter>
+
+#include <iomanip>
+#include <iostream>
+
+static const int kDefaultDuration = 1000;
+static const int kDefaultDataSize = 64;
+static const int kDefaultAppcastItems = 1000;
+static const qint64 kDefaultTreeChunkSize = 1024 * 1024;
+static const char * const kDefaultKeys = "ed25519,dsa:2048,dsa:3072";
+
+struct BenchResult
+{
+	QString benchmark;
+	QString name;
+	double value;
+	QString unit;
+};
+
+struct BenchKey
+{
+	QString name;
+	QGlitterPrivateKey privateKey;
+	QGlitterPublicKey publicKey;
+};
+
+// Runs body until at least duration milliseconds have passed, returns the iteration count
+// and the elapsed time in seconds. A failing body stops the run and describes why in errorMessage.
+template<typename Body>
+static qint64 repeat(int duration, double *seconds, QString *errorMessage, Body body)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	qint64 iterations = 0;
+	do {
+		if (!body(errorMessage)) {
+			return -1;
+		}
+		++iterations;
+	} while (timer.elapsed() < duration);
+
+	*seconds = timer.nsecsElapsed() / 1e9;
+
+	return iterations;
+}
+
+struct DigestFile
+{
+	DigestFile(const QString &fileName, QGlitter::SignatureAlgorithm algorithm)
+		: fileName(fileName)
+		, algorithm(algorithm)
+	{
+	}
+
+	bool operator()(QString *errorMessage) const
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly)) {
+			*errorMessage = "Unable to read " + fileName;
+			return false;
+		}
+
+		QGlitter::CryptoResult result = QGlitter::digestDevice(file, algorithm);
+		*errorMessage = result.errorMessage;
+		return result.success;
+	}
+
+	QString fileName;
+	QGlitter::SignatureAlgorithm algorithm;
+};
+
+struct DigestTree
+{
+	DigestTree(const QString &fileName, qint64 chunkSize)
+		: fileName(fileName)
+		, chunkSize(chunkSize)
+	{
+	}
+
+	bool operator()(QString *errorMessage) const
+	{
+		QFile file(fileName);
+		if (!file.open(QIODevice::ReadOnly)) {
+			*errorMessage = "Unable to read " + fileName;
+			return false;
+		}
+
+		QGlitter::CryptoResult result = QGlitter::treeDigest(file, chunkSize);
+		*errorMessage = result.errorMessage;
+		return result.success;
+	}
+
+	QString fileName;
+	qint64 chunkSize;
+};
+
+struct SignDigest
+{
+	SignDigest(const QByteArray &digest, const QGlitterPrivateKey &privateKey)
+		: digest(digest)
+		, privateKey(privateKey)
+	{
+	}
+
+	bool operator()(QString *errorMessage) const
+	{
+		QGlitter::CryptoResult result = QGlitter::signDigest(digest, privateKey);
+		*errorMessage = result.errorMessage;
+		return result.success;
+	}
+
+	QByteArray digest;
+	QGlitterPrivateKey privateKey;
+};
+
+struct VerifyDigest
+{
+	VerifyDigest(const QByteArray &digest, const QByteArray &signature, const QGlitterPublicKey &publicKey)
+		: digest(digest)
+		, signature(signature)
+		, publicKey(publicKey)
+	{
+	}
+
+	bool operator()(QString *errorMessage) const
+	{
+		QGlitter::CryptoResult result = QGlitter::verifyDigest(digest, signature, publicKey);
+		*errorMessage = result.errorMessage;
+		return result.success;
+	}
+
+	QByteArray digest;
+	QByteArray signature;
+	QGlitterPublicKey publicKey;
+};
+
+struct ParseAppcast
+{
+	ParseAppcast(const QByteArray &feed)
+		: feed(feed)
+	{
+	}
+
+	bool operator()(QString *errorMessage) const
+	{
+		QBuffer buffer;
+		buffer.setData(feed);
+		buffer.open(QIODevice::ReadOnly);
+
+		QGlitterAppcast appcast;
+		if (!appcast.read(&buffer)) {
+			*errorMessage = "Unable to parse the feed";
+			return false;
+		}
+
+		return true;
+	}
+
+	QByteArray feed;
+};
+
+static QByteArray generateFeed(int itemCount)
+{
+	QBuffer buffer;
+	buffer.open(QIODevice::WriteOnly);
+
+	QXmlStreamWriter xml(&buffer);
+	xml.writeStartDocument();
+	xml.writeStartElement("rss");
+	xml.writeAttribute("version", "2.0");
+	xml.writeNamespace(kSparkleNamespace, "sparkle");
+	xml.writeStartElement("channel");
+	xml.writeTextElement("title", "Benchmark");
+
+	for (int i = 0; i < itemCount; ++i) {
+		QString version = QString("1.%1.%2").arg(i / 100).arg(i % 100);
+
+		xml.writeStartElement("item");
+		xml.writeTextElement("title", "Benchmark " + version);
+		xml.writeTextElement("pubDate", "Mon, 01 Jan 2024 12:00:00 +0000");
+		xml.writeTextElement(kSparkleNamespace, "releaseNotesLink", "https://example.com/notes/" + version + ".html");
+		xml.writeStartElement("enclosure");
+		xml.writeAttribute("url", "https://example.com/Benchmark-" + version + ".zip");
+		xml.writeAttribute("length", QString::number(1000000 + i));
+		xml.writeAttribute("type", "application/octet-stream");
+		xml.writeAttribute(kSparkleNamespace, "version", version);
+		xml.writeAttribute(kSparkleNamespace, "ed25519Signature", QString(QByteArray(88, 'A').toBase64()));
+		xml.writeEndElement();
+		xml.writeEndElement();
+	}
+
+	xml.writeEndDocument();
+
+	return buffer.data();
+}
+
+static bool generateData(QTemporaryFile *file, int megabytes)
+{
+	if (!file->open()) {
+		return false;
+	}
+
+	// Random enough that nothing between us and the disk can compress it
+	QByteArray block(1024 * 1024, 0);
+	quint32 state = 0x9e3779b9;
+	for (int i = 0; i < megabytes; ++i) {
+		for (int j = 0; j < block.size(); ++j) {
+			state = state * 1664525 + 1013904223;
+			block[j] = (char)(state >> 24);
+		}
+
+		if (file->write(block) != block.size()) {
+			return false;
+		}
+	}
+
+	return file->flush();
+}
+
+static bool parseKeys(const QString &value, QList<BenchKey> *keys)
+{
+	foreach (const QString &spec, value.split(',', QString::SkipEmptyParts)) {
+		QStringList parts = spec.split(':');
+
+		QGlitter::SignatureAlgorithm algorithm = QGlitter::signatureAlgorithmFromName(parts.first());
+		int size = parts.size() > 1 ? parts.at(1).toInt() : 0;
+		if (algorithm == QGlitter::UnknownSignatureAlgorithm || (algorithm == QGlitter::DsaSha1 && size < 1024)) {
+			std::cerr << "Unknown key type " << spec.toStdString() << std::endl;
+			return false;
+		}
+
+		QByteArray privateKey;
+		QByteArray publicKey;
+		if (!QGlitter::generateKeyPair(algorithm, size, "", &privateKey, &publicKey)) {
+			std::cerr << "Unable to generate " << spec.toStdString() << " key: " << QGlitter::errorMessage().toStdString() << std::endl;
+			return false;
+		}
+
+		BenchKey key;
+		key.name = algorithm == QGlitter::DsaSha1 ? QString("dsa-%1").arg(size) : QGlitter::signatureAlgorithmName(algorithm);
+		key.privateKey = QGlitterPrivateKey(privateKey, "");
+		key.publicKey = QGlitterPublicKey(publicKey);
+		*keys << key;
+	}
+
+	return true;
+}
+
+template<typename Body>
+static bool measure(QList<BenchResult> *results, const QString &benchmark, const QString &name, int duration, double scale, const QString &unit, Body body)
+{
+	double seconds = 0;
+	QString errorMessage;
+	qint64 iterations = repeat(duration, &seconds, &errorMessage, body);
+	if (iterations < 0) {
+		std::cerr << "ERROR: " << benchmark.toStdString() << " " << name.toStdString() << ": " << errorMessage.toStdString() << std::endl;
+		return false;
+	}
+
+	BenchResult result;
+	result.benchmark = benchmark;
+	result.name = name;
+	result.value = iterations * scale / seconds;
+	result.unit = unit;
+	*results << result;
+
+	std::cerr << ".";
+
+	return true;
+}
+
+void printBenchUsage()
+{
+	std::cerr << "    qglitter-tool bench [--format text|json] [--duration <ms>] [--size <megabytes>] [--tree <chunksize>]" << std::endl;
+	std::cerr << "                        [--keys <type[:size]>,...] [--appcast <file>] [--items <count>] [file...]" << std::endl;
+}
+
+int bench(QStringList arguments)
+{
+	QString value;
+
+	QString format = "text";
+	if (takeOption(arguments, "--format", &value)) {
+		format = value;
+	}
+
+	int duration = kDefaultDuration;
+	if (takeOption(arguments, "--duration", &value)) {
+		duration = value.toInt();
+	}
+
+	int dataSize = kDefaultDataSize;
+	if (takeOption(arguments, "--size", &value)) {
+		dataSize = value.toInt();
+	}
+
+	qint64 treeChunkSize = kDefaultTreeChunkSize;
+	if (takeOption(arguments, "--tree", &value)) {
+		treeChunkSize = value.toLongLong();
+	}
+
+	QString keySpecs = kDefaultKeys;
+	takeOption(arguments, "--keys", &keySpecs);
+
+	QString appcastFile = "";
+	takeOption(arguments, "--appcast", &appcastFile);
+
+	int appcastItems = kDefaultAppcastItems;
+	if (takeOption(arguments, "--items", &value)) {
+		appcastItems = value.toInt();
+	}
+
+	if ((format != "text" && format != "json") || duration <= 0 || dataSize <= 0 || treeChunkSize <= 0 || appcastItems <= 0) {
+		printBenchUsage();
+		return -1;
+	}
+
+	QGlitter::cryptoInit();
+
+	QList<BenchKey> keys;
+	if (!parseKeys(keySpecs, &keys)) {
+		return -1;
+	}
+
+	// Caller supplied files, or generated data when there are none
+	QTemporaryFile generatedData;
+	QStringList files = collectFiles(arguments);
+	bool generated = files.isEmpty();
+	if (generated) {
+		if (!generateData(&generatedData, dataSize)) {
+			std::cerr << "Unable to write benchmark data to " << generatedData.fileName().toStdString() << std::endl;
+			return -1;
+		}
+
+		files << generatedData.fileName();
+	}
+
+	QByteArray feed;
+	QString feedName = QString("generated (%1 items)").arg(appcastItems);
+	if (appcastFile.size()) {
+		QFile file(appcastFile);
+		if (!file.open(QIODevice::ReadOnly)) {
+			std::cerr << "Unable to read " << appcastFile.toStdString() << std::endl;
+			return -1;
+		}
+
+		feed = file.readAll();
+		feedName = QFileInfo(appcastFile).fileName();
+	} else {
+		feed = generateFeed(appcastItems);
+	}
+
+	QList<BenchResult> results;
+
+	foreach (const QString &fileName, files) {
+		QString label = generated ? QString("generated (%1 MB)").arg(dataSize) : QFileInfo(fileName).fileName();
+		double megabytes = QFileInfo(fileName).size() / (1024.0 * 1024.0);
+
+		if (!measure(&results, "digest", "sha1 " + label, duration, megabytes, "MB/s", DigestFile(fileName, QGlitter::DsaSha1))
+			|| !measure(&results, "digest", "sha256 " + label, duration, megabytes, "MB/s", DigestFile(fileName, QGlitter::Ed25519Sha256))
+			|| !measure(&results, "digest", QString("tree:%1 %2").arg(treeChunkSize).arg(label), duration, megabytes, "MB/s", DigestTree(fileName, treeChunkSize))) {
+			return -3;
+		}
+	}
+
+	foreach (const BenchKey &key, keys) {
+		QBuffer buffer;
+		buffer.setData(QByteArray("qglitter"));
+		buffer.open(QIODevice::ReadOnly);
+
+		QByteArray digest = QGlitter::digestDevice(buffer, key.privateKey.algorithm()).digest;
+		QByteArray signature = QGlitter::signDigest(digest, key.privateKey).signature;
+
+		if (!measure(&results, "sign", key.name, duration, 1, "ops/s", SignDigest(digest, key.privateKey))
+			|| !measure(&results, "verify", key.name, duration, 1, "ops/s", VerifyDigest(digest, signature, key.publicKey))) {
+			return -3;
+		}
+	}
+
+	// QXmlStreamReader is the only parser QGlitterAppcast has
+	int itemCount = 0;
+	{
+		QBuffer buffer;
+		buffer.setData(feed);
+		buffer.open(QIODevice::ReadOnly);
+
+		QGlitterAppcast appcast;
+		if (!appcast.read(&buffer)) {
+			std::cerr << "Unable to parse " << feedName.toStdString() << std::endl;
+			return -3;
+		}
+		itemCount = appcast.items().size();
+	}
+
+	if (!measure(&results, "appcast", "QXmlStreamReader " + feedName, duration, itemCount, "items/s", ParseAppcast(feed))) {
+		return -3;
+	}
+
+	std::cerr << std::endl;
+
+	if (format == "json") {
+		std::cout << "[" << std::endl;
+	}
+
+	bool first = true;
+	foreach (const BenchResult &result, results) {
+		if (format == "json") {
+			std::cout << (first ? "" : ",\n") << "\t{ \"benchmark\": " << jsonString(result.benchmark).toStdString()
+				<< ", \"name\": " << jsonString(result.name).toStdString()
+				<< ", \"value\": " << std::fixed << std::setprecision(1) << result.value
+				<< ", \"unit\": " << jsonString(result.unit).toStdString() << " }";
+		} else {
+			std::cout << std::left << std::setw(10) << result.benchmark.toStdString() << std::setw(48) << result.name.toStdString()
+				<< std::right << std::setw(14) << std::fixed << std::setprecision(1) << result.value << " " << result.unit.toStdString() << std::endl;
+		}
+
+		first = false;
+	}
+
+	if (format == "json") {
+		std::cout << (first ? "" : "\n") << "]" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "Common.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+#include <iostream>
+#include <string>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <stdio.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+bool takeOption(QStringList &arguments, const QString &name, QString *value)
+{
+	int index = arguments.indexOf(name);
+	if (index < 0 || index + 1 >= arguments.size()) {
+		return false;
+	}
+
+	*value = arguments.at(index + 1);
+
+	arguments.removeAt(index);
+	arguments.removeAt(index);
+
+	return true;
+}
+
+bool takeFlag(QStringList &arguments, const QString &name)
+{
+	return arguments.removeAll(name) > 0;
+}
+
+bool readKeyFile(const QString &fileName, QByteArray *keyData)
+{
+	QFile key(fileName);
+	if (!key.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		std::cerr << "Unable to read keyfile: " << fileName.toStdString() << std::endl;
+		return false;
+	}
+
+	*keyData = key.readAll();
+
+	return true;
+}
+
+// Keeps the terminal from showing the passphrase while it's typed, for as long as it's in scope
+class EchoDisabler
+{
+public:
+	EchoDisabler()
+		: m_isDisabled(false)
+	{
+#ifdef Q_OS_WIN
+		m_console = GetStdHandle(STD_INPUT_HANDLE);
+		if (GetConsoleMode(m_console, &m_mode)) {
+			m_isDisabled = SetConsoleMode(m_console, m_mode & ~ENABLE_ECHO_INPUT) != 0;
+		}
+#else
+		if (tcgetattr(STDIN_FILENO, &m_mode) == 0) {
+			struct termios silent = m_mode;
+			silent.c_lflag &= ~ECHO;
+			m_isDisabled = tcsetattr(STDIN_FILENO, TCSAFLUSH, &silent) == 0;
+		}
+#endif
+	}
+
+	~EchoDisabler()
+	{
+		if (!m_isDisabled) {
+			return;
+		}
+
+#ifdef Q_OS_WIN
+		SetConsoleMode(m_console, m_mode);
+#else
+		tcsetattr(STDIN_FILENO, TCSAFLUSH, &m_mode);
+#endif
+	}
+
+private:
+	bool m_isDisabled;
+#ifdef Q_OS_WIN
+	HANDLE m_console;
+	DWORD m_mode;
+#else
+	struct termios m_mode;
+#endif
+};
+
+static bool stdinIsTerminal()
+{
+#ifdef Q_OS_WIN
+	return _isatty(_fileno(stdin)) != 0;
+#else
+	return isatty(STDIN_FILENO) != 0;
+#endif
+}
+
+QString readPassphrase(const QString &environmentVariable, const QByteArray &keyData)
+{
+	if (environmentVariable.size()) {
+		return QString::fromLocal8Bit(qgetenv(environmentVariable.toLocal8Bit().constData()));
+	}
+
+	// Both "ENCRYPTED PRIVATE KEY" and the older "Proc-Type: 4,ENCRYPTED" header, anything else loads without one
+	if (!keyData.contains("ENCRYPTED")) {
+		return QString();
+	}
+
+	std::string line;
+	if (stdinIsTerminal()) {
+		std::cerr << "Passphrase: " << std::flush;
+
+		EchoDisabler echoDisabler;
+		std::getline(std::cin, line);
+
+		std::cerr << std::endl;
+	} else {
+		std::getline(std::cin, line);
+	}
+
+	return QString::fromLocal8Bit(line.c_str());
+}
+
+QStringList collectFiles(const QStringList &paths)
+{
+	QStringList files;
+
+	foreach (const QString &path, paths) {
+		if (!QFileInfo(path).isDir()) {
+			files << path;
+			continue;
+		}
+
+		QStringList directoryFiles;
+		QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+		while (it.hasNext()) {
+			directoryFiles << it.next();
+		}
+
+		directoryFiles.sort();
+		files << directoryFiles;
+	}
+
+	return files;
+}
+
+QString jsonString(const QString &value)
+{
+	QString escaped = "\"";
+
+	for (int i = 0; i < value.size(); ++i) {
+		QChar c = value.at(i);
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+			escaped += c;
+		} else if (c == '\n') {
+			escaped += "\\n";
+		} else if (c == '\t') {
+			escaped += "\\t";
+		} else if (c.unicode() < 0x20) {
+			escaped += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+		} else {
+			escaped += c;
+		}
+	}
+
+	escaped += '"';
+
+	return escaped;
+}
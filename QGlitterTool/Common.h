@@ -0,0 +1,42 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+static const char * const kSparkleNamespace = "http://www.andymatuschak.org/xml-namespaces/sparkle";
+
+// Removes "--name value" from arguments, returns false when the option is absent or has no value
+bool takeOption(QStringList &arguments, const QString &name, QString *value);
+bool takeFlag(QStringList &arguments, const QString &name);
+
+bool readKeyFile(const QString &fileName, QByteArray *keyData);
+
+// Reads the passphrase from the named environment variable, an unset variable meaning none. Without a name
+// an encrypted key's passphrase is read from stdin, without echo on a terminal. Unencrypted keys need none.
+QString readPassphrase(const QString &environmentVariable, const QByteArray &keyData);
+
+// Expands directories into the regular files below them, sorted by path
+QStringList collectFiles(const QStringList &paths);
+
+QString jsonString(const QString &value);
@@ -0,0 +1,315 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "GenerateAppcast.h"
+#include "Common.h"
+#include "SignBatch.h"
+#include "QGlitter/QGlitterDefaultVersionComparator.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QLocale>
+#include <QPair>
+#include <QRegExp>
+#include <QXmlStreamWriter>
+#include <QtAlgorithms>
+#include <QtConcurrentMap>
+
+#include <iostream>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+static const char * const kCacheFileName = ".qglitter-appcast-cache";
+
+bool parseArtifactName(const QString &fileName, Artifact *artifact)
+{
+	static const char * const kDoubleExtensions[] = { ".tar.gz", ".tar.bz2", ".tar.xz", 0 };
+
+	QString baseName = QFileInfo(fileName).completeBaseName();
+	for (int i = 0; kDoubleExtensions[i]; ++i) {
+		if (fileName.endsWith(kDoubleExtensions[i], Qt::CaseInsensitive)) {
+			baseName = fileName.left(fileName.size() - qstrlen(kDoubleExtensions[i]));
+			break;
+		}
+	}
+
+	QRegExp pattern("^(.+)-(\\d[^-]*)(?:-([A-Za-z0-9_]+))?$");
+	if (!pattern.exactMatch(baseName)) {
+		return false;
+	}
+
+	artifact->name = pattern.cap(1);
+	artifact->version = pattern.cap(2);
+	artifact->operatingSystem = pattern.cap(3);
+
+	return true;
+}
+
+// Identifies the file contents without reading them, so unchanged artifacts aren't hashed again
+static QString artifactCacheKey(const QString &path, const QString &mode)
+{
+#ifdef Q_OS_UNIX
+	struct stat status;
+	if (stat(QFile::encodeName(path).constData(), &status) == 0) {
+		return QString("%1 %2 %3 %4").arg((qulonglong)status.st_ino).arg((qlonglong)status.st_size).arg((qlonglong)status.st_mtime).arg(mode);
+	}
+#endif
+
+	QFileInfo info(path);
+	return QString("%1 %2 %3 %4").arg(info.fileName()).arg(info.size()).arg(info.lastModified().toTime_t()).arg(mode);
+}
+
+// One "<key>\t<digest>\t<signature>" line per artifact
+static QHash<QString, QPair<QByteArray, QByteArray> > readCache(const QString &fileName)
+{
+	QHash<QString, QPair<QByteArray, QByteArray> > cache;
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		return cache;
+	}
+
+	while (!file.atEnd()) {
+		QList<QByteArray> fields = file.readLine().trimmed().split('\t');
+		if (fields.size() == 3) {
+			cache.insert(QString::fromUtf8(fields.at(0)), qMakePair(fields.at(1), fields.at(2)));
+		}
+	}
+
+	return cache;
+}
+
+static void writeCache(const QString &fileName, const QList<Artifact> &artifacts)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		std::cerr << "WARNING: Unable to write " << fileName.toStdString() << std::endl;
+		return;
+	}
+
+	foreach (const Artifact &artifact, artifacts) {
+		if (artifact.signature.size()) {
+			file.write(artifact.cacheKey.toUtf8() + "\t" + artifact.digest + "\t" + artifact.signature + "\n");
+		}
+	}
+}
+
+static bool artifactLessThan(const Artifact &lhs, const Artifact &rhs)
+{
+	int versionOrder = QGlitter::defaultVersionComparator(lhs.version, rhs.version);
+	if (versionOrder != 0) {
+		return versionOrder > 0;
+	}
+
+	return lhs.operatingSystem < rhs.operatingSystem;
+}
+
+static QString rfc822Date(const QDateTime &dateTime)
+{
+	return QLocale::c().toString(dateTime.toUTC(), "ddd, dd MMM yyyy hh:mm:ss") + " +0000";
+}
+
+void printAppcastUsage()
+{
+	std::cerr << "    qglitter-tool appcast [--key <keyfile>] [--passphrase-env <variable>] [--tree <chunksize>]" << std::endl;
+	std::cerr << "                          [--url <base url>] [--title <title>] [--output <file>] <release-dir>" << std::endl;
+}
+
+int generateAppcast(QStringList arguments)
+{
+	QString value;
+
+	qint64 treeChunkSize = 0;
+	if (takeOption(arguments, "--tree", &value)) {
+		bool ok = false;
+		treeChunkSize = value.toLongLong(&ok);
+		if (!ok || treeChunkSize <= 0) {
+			printAppcastUsage();
+			return -1;
+		}
+	}
+
+	QString keyFile = "";
+	takeOption(arguments, "--key", &keyFile);
+
+	QString passphraseVariable = "";
+	takeOption(arguments, "--passphrase-env", &passphraseVariable);
+
+	QString baseUrl = "";
+	takeOption(arguments, "--url", &baseUrl);
+	if (baseUrl.size() && !baseUrl.endsWith("/")) {
+		baseUrl += "/";
+	}
+
+	QString title = "";
+	takeOption(arguments, "--title", &title);
+
+	QString output = "";
+	takeOption(arguments, "--output", &output);
+
+	if (arguments.size() != 1 || !QFileInfo(arguments.first()).isDir()) {
+		printAppcastUsage();
+		return -1;
+	}
+
+	QDir releaseDir(arguments.first());
+
+	QGlitterPrivateKey privateKey;
+	QString signatureAttribute = "";
+	QString mode = "";
+	if (keyFile.size()) {
+		QByteArray keyData;
+		if (!readKeyFile(keyFile, &keyData)) {
+			return -1;
+		}
+
+		privateKey = QGlitterPrivateKey(keyData, readPassphrase(passphraseVariable, keyData));
+		if (!privateKey.isValid()) {
+			std::cerr << "ERROR: " << QGlitter::errorMessage().toStdString() << std::endl;
+			return -1;
+		}
+
+		signatureAttribute = privateKey.algorithm() == QGlitter::DsaSha1 ? "dsaSignature" : "ed25519Signature";
+
+		// A different key or chunk size makes every cached signature stale
+		mode = QString("%1:%2").arg(QString(QCryptographicHash::hash(keyData, QCryptographicHash::Sha1).toHex())).arg(treeChunkSize);
+	}
+
+	QString cacheFileName = releaseDir.absoluteFilePath(kCacheFileName);
+	QHash<QString, QPair<QByteArray, QByteArray> > cache = readCache(cacheFileName);
+
+	QList<Artifact> artifacts;
+	QStringList pathsToSign;
+
+	foreach (const QFileInfo &info, releaseDir.entryInfoList(QDir::Files, QDir::Name)) {
+		Artifact artifact;
+		if (!parseArtifactName(info.fileName(), &artifact)) {
+			std::cerr << "WARNING: Skipping " << info.fileName().toStdString() << ", expected <name>-<version>[-<os>].<extension>" << std::endl;
+			continue;
+		}
+
+		artifact.path = info.absoluteFilePath();
+		artifact.fileName = info.fileName();
+		artifact.length = info.size();
+		artifact.modified = info.lastModified();
+
+		if (privateKey.isValid()) {
+			artifact.cacheKey = artifactCacheKey(artifact.path, mode);
+			if (cache.contains(artifact.cacheKey)) {
+				artifact.digest = cache.value(artifact.cacheKey).first;
+				artifact.signature = cache.value(artifact.cacheKey).second;
+			} else {
+				pathsToSign << artifact.path;
+			}
+		}
+
+		artifacts << artifact;
+	}
+
+	if (pathsToSign.size()) {
+		std::cerr << "Signing " << pathsToSign.size() << " of " << artifacts.size() << " artifacts" << std::endl;
+
+		QList<BatchEntry> entries = QtConcurrent::blockingMapped<QList<BatchEntry> >(pathsToSign, SignFile(privateKey, treeChunkSize));
+
+		QHash<QString, BatchEntry> signedFiles;
+		foreach (const BatchEntry &entry, entries) {
+			if (!entry.result.success) {
+				std::cerr << "ERROR: " << entry.path.toStdString() << ": " << entry.result.errorMessage.toStdString() << std::endl;
+				return -3;
+			}
+
+			signedFiles.insert(entry.path, entry);
+		}
+
+		for (int i = 0; i < artifacts.size(); ++i) {
+			if (signedFiles.contains(artifacts.at(i).path)) {
+				const BatchEntry &entry = signedFiles[artifacts.at(i).path];
+				artifacts[i].digest = entry.result.digest.toHex();
+				artifacts[i].signature = entry.result.signature.toBase64();
+			}
+		}
+	}
+
+	if (privateKey.isValid()) {
+		writeCache(cacheFileName, artifacts);
+	}
+
+	qSort(artifacts.begin(), artifacts.end(), artifactLessThan);
+
+	QFile outputFile;
+	bool opened = false;
+	if (output.size()) {
+		outputFile.setFileName(output);
+		opened = outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	} else {
+		opened = outputFile.open(stdout, QIODevice::WriteOnly);
+	}
+
+	if (!opened) {
+		std::cerr << "Unable to write " << output.toStdString() << std::endl;
+		return -1;
+	}
+
+	QXmlStreamWriter xml(&outputFile);
+	xml.setAutoFormatting(true);
+	xml.writeStartDocument();
+	xml.writeNamespace(kSparkleNamespace, "sparkle");
+	xml.writeStartElement("rss");
+	xml.writeAttribute("version", "2.0");
+	xml.writeStartElement("channel");
+	xml.writeTextElement("title", title.size() ? title : (artifacts.size() ? artifacts.first().name : releaseDir.dirName()));
+
+	foreach (const Artifact &artifact, artifacts) {
+		xml.writeStartElement("item");
+		xml.writeTextElement("title", artifact.name + " " + artifact.version);
+		xml.writeTextElement("pubDate", rfc822Date(artifact.modified));
+
+		xml.writeStartElement("enclosure");
+		xml.writeAttribute("url", baseUrl + artifact.fileName);
+		xml.writeAttribute("length", QString::number(artifact.length));
+		xml.writeAttribute("type", "application/octet-stream");
+		xml.writeAttribute(kSparkleNamespace, "version", artifact.version);
+		if (artifact.operatingSystem.size()) {
+			xml.writeAttribute(kSparkleNamespace, "os", artifact.operatingSystem);
+		}
+		if (artifact.signature.size()) {
+			xml.writeAttribute(kSparkleNamespace, signatureAttribute, QString::fromLatin1(artifact.signature));
+		}
+		if (artifact.signature.size() && treeChunkSize > 0) {
+			xml.writeAttribute(kSparkleNamespace, "treeChunkSize", QString::number(treeChunkSize));
+		}
+		xml.writeEndElement();
+
+		xml.writeEndElement();
+	}
+
+	xml.writeEndElement();
+	xml.writeEndElement();
+	xml.writeEndDocument();
+
+	return 0;
+}
@@ -0,0 +1,321 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "GenerateDeltas.h"
+#include "Common.h"
+#include "GenerateAppcast.h"
+#include "SignBatch.h"
+#include "QGlitter/QGlitterDefaultVersionComparator.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QProcess>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QXmlStreamWriter>
+#include <QtAlgorithms>
+#include <QtConcurrentMap>
+
+#include <iostream>
+
+static const char * const kDefaultDiffTool = "bsdiff";
+static const int kDefaultMemoryBudget = 4096;
+static const int kDefaultDeltaCount = 3;
+
+// bsdiff needs roughly 17 bytes per byte of the old file plus the new file
+static const int kDefaultMemoryFactor = 17;
+
+struct DeltaJob
+{
+	Artifact from;
+	Artifact to;
+	QString deltaPath;
+	int memoryCost;
+};
+
+struct DeltaResult
+{
+	DeltaJob job;
+	QString errorMessage;
+	qint64 length;
+	QGlitter::CryptoResult signature;
+};
+
+// Jobs reserve their estimated memory from a shared budget before the diff tool starts,
+// so a few large diffs run alone while small ones run side by side
+struct RunDelta
+{
+	typedef DeltaResult result_type;
+
+	RunDelta(const QStringList &tool, QSemaphore *memory, const QGlitterPrivateKey &privateKey, qint64 treeChunkSize)
+		: tool(tool)
+		, memory(memory)
+		, privateKey(privateKey)
+		, treeChunkSize(treeChunkSize)
+	{
+	}
+
+	DeltaResult operator()(const DeltaJob &job) const
+	{
+		DeltaResult result;
+		result.job = job;
+		result.length = 0;
+
+		QStringList arguments = tool.mid(1);
+		arguments << job.from.path << job.to.path << job.deltaPath;
+
+		memory->acquire(job.memoryCost);
+
+		QProcess process;
+		process.start(tool.first(), arguments);
+		bool finished = process.waitForStarted(-1) && process.waitForFinished(-1);
+
+		memory->release(job.memoryCost);
+
+		if (!finished || process.exitStatus() != QProcess::NormalExit) {
+			result.errorMessage = QString("%1 failed: %2").arg(tool.join(" ")).arg(process.errorString());
+			QFile::remove(job.deltaPath);
+			return result;
+		}
+
+		if (process.exitCode() != 0) {
+			QString errorOutput = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+			result.errorMessage = QString("%1 exited with code %2").arg(tool.join(" ")).arg(process.exitCode());
+			if (errorOutput.size()) {
+				result.errorMessage += ": " + errorOutput;
+			}
+			QFile::remove(job.deltaPath);
+			return result;
+		}
+
+		result.length = QFileInfo(job.deltaPath).size();
+
+		if (privateKey.isValid()) {
+			result.signature = SignFile(privateKey, treeChunkSize)(job.deltaPath).result;
+			if (!result.signature.success) {
+				result.errorMessage = result.signature.errorMessage;
+			}
+		}
+
+		return result;
+	}
+
+	QStringList tool;
+	QSemaphore *memory;
+	QGlitterPrivateKey privateKey;
+	qint64 treeChunkSize;
+};
+
+static bool artifactNewerThan(const Artifact &lhs, const Artifact &rhs)
+{
+	return QGlitter::defaultVersionComparator(lhs.version, rhs.version) > 0;
+}
+
+static bool jobLargerThan(const DeltaJob &lhs, const DeltaJob &rhs)
+{
+	return lhs.memoryCost > rhs.memoryCost;
+}
+
+void printDeltasUsage()
+{
+	std::cerr << "    qglitter-tool delta [--count <n>] [--tool <command>] [--memory <megabytes>] [--jobs <count>]" << std::endl;
+	std::cerr << "                        [--key <keyfile>] [--passphrase-env <variable>] [--tree <chunksize>]" << std::endl;
+	std::cerr << "                        [--url <base url>] <release-dir> <new artifact>" << std::endl;
+}
+
+int generateDeltas(QStringList arguments)
+{
+	QString value;
+	bool ok = true;
+
+	int deltaCount = kDefaultDeltaCount;
+	if (ok && takeOption(arguments, "--count", &value)) {
+		deltaCount = value.toInt(&ok);
+	}
+
+	QStringList tool = QString(kDefaultDiffTool).split(' ');
+	if (takeOption(arguments, "--tool", &value)) {
+		tool = value.split(' ', QString::SkipEmptyParts);
+	}
+
+	int memoryBudget = kDefaultMemoryBudget;
+	if (ok && takeOption(arguments, "--memory", &value)) {
+		memoryBudget = value.toInt(&ok);
+	}
+
+	int jobCount = QThreadPool::globalInstance()->maxThreadCount();
+	if (ok && takeOption(arguments, "--jobs", &value)) {
+		jobCount = value.toInt(&ok);
+	}
+
+	qint64 treeChunkSize = 0;
+	if (ok && takeOption(arguments, "--tree", &value)) {
+		treeChunkSize = value.toLongLong(&ok);
+	}
+
+	QString keyFile = "";
+	takeOption(arguments, "--key", &keyFile);
+
+	QString passphraseVariable = "";
+	takeOption(arguments, "--passphrase-env", &passphraseVariable);
+
+	QString baseUrl = "";
+	takeOption(arguments, "--url", &baseUrl);
+	if (baseUrl.size() && !baseUrl.endsWith("/")) {
+		baseUrl += "/";
+	}
+
+	if (!ok || arguments.size() != 2 || deltaCount <= 0 || memoryBudget <= 0 || jobCount <= 0 || tool.isEmpty() || treeChunkSize < 0) {
+		printDeltasUsage();
+		return -1;
+	}
+
+	QThreadPool::globalInstance()->setMaxThreadCount(jobCount);
+
+	QDir releaseDir(arguments.at(0));
+
+	Artifact target;
+	QFileInfo targetInfo(arguments.at(1));
+	if (!targetInfo.isFile() || !parseArtifactName(targetInfo.fileName(), &target)) {
+		std::cerr << "ERROR: " << arguments.at(1).toStdString() << " is not named <name>-<version>[-<os>].<extension>" << std::endl;
+		return -1;
+	}
+
+	target.path = targetInfo.absoluteFilePath();
+	target.fileName = targetInfo.fileName();
+	target.length = targetInfo.size();
+
+	QGlitterPrivateKey privateKey;
+	if (keyFile.size()) {
+		QByteArray keyData;
+		if (!readKeyFile(keyFile, &keyData)) {
+			return -1;
+		}
+
+		privateKey = QGlitterPrivateKey(keyData, readPassphrase(passphraseVariable, keyData));
+		if (!privateKey.isValid()) {
+			std::cerr << "ERROR: " << QGlitter::errorMessage().toStdString() << std::endl;
+			return -1;
+		}
+	}
+
+	// Earlier releases of the same product for the same platform
+	QList<Artifact> previousReleases;
+	foreach (const QFileInfo &info, releaseDir.entryInfoList(QDir::Files, QDir::Name)) {
+		Artifact artifact;
+		if (!parseArtifactName(info.fileName(), &artifact)) {
+			continue;
+		}
+
+		if (artifact.name != target.name || artifact.operatingSystem != target.operatingSystem) {
+			continue;
+		}
+
+		if (QGlitter::defaultVersionComparator(artifact.version, target.version) >= 0) {
+			continue;
+		}
+
+		artifact.path = info.absoluteFilePath();
+		artifact.fileName = info.fileName();
+		artifact.length = info.size();
+		previousReleases << artifact;
+	}
+
+	qSort(previousReleases.begin(), previousReleases.end(), artifactNewerThan);
+	previousReleases = previousReleases.mid(0, deltaCount);
+
+	if (previousReleases.isEmpty()) {
+		std::cerr << "No earlier releases of " << target.name.toStdString() << " found" << std::endl;
+		return 0;
+	}
+
+	// Deltas live in their own directory so 'appcast' doesn't mistake them for full releases
+	QString deltaDirectory = releaseDir.absoluteFilePath("deltas");
+	if (!QDir().mkpath(deltaDirectory)) {
+		std::cerr << "Unable to create " << deltaDirectory.toStdString() << std::endl;
+		return -1;
+	}
+
+	QList<DeltaJob> jobs;
+	foreach (const Artifact &from, previousReleases) {
+		QString suffix = target.operatingSystem.size() ? "-" + target.operatingSystem : QString();
+
+		DeltaJob job;
+		job.from = from;
+		job.to = target;
+		job.deltaPath = QDir(deltaDirectory).absoluteFilePath(QString("%1-%2-to-%3%4.delta").arg(target.name).arg(from.version).arg(target.version).arg(suffix));
+
+		qint64 estimate = (kDefaultMemoryFactor * from.length + target.length) / (1024 * 1024) + 1;
+		job.memoryCost = (int)qMin<qint64>(estimate, memoryBudget);
+
+		jobs << job;
+	}
+
+	// Starting the largest diffs first keeps the budget from idling at the end
+	qSort(jobs.begin(), jobs.end(), jobLargerThan);
+
+	QSemaphore memory(memoryBudget);
+	QList<DeltaResult> results = QtConcurrent::blockingMapped<QList<DeltaResult> >(jobs, RunDelta(tool, &memory, privateKey, treeChunkSize));
+
+	QFile output;
+	output.open(stdout, QIODevice::WriteOnly);
+
+	QXmlStreamWriter xml(&output);
+	xml.setAutoFormatting(true);
+
+	int failures = 0;
+	foreach (const DeltaResult &result, results) {
+		if (result.errorMessage.size()) {
+			std::cerr << "ERROR: " << result.job.deltaPath.toStdString() << ": " << result.errorMessage.toStdString() << std::endl;
+			++failures;
+			continue;
+		}
+
+		xml.writeStartElement("item");
+		xml.writeNamespace(kSparkleNamespace, "sparkle");
+		xml.writeTextElement("title", target.name + " " + target.version);
+
+		xml.writeStartElement("enclosure");
+		xml.writeAttribute("url", baseUrl + "deltas/" + QFileInfo(result.job.deltaPath).fileName());
+		xml.writeAttribute("length", QString::number(result.length));
+		xml.writeAttribute("type", "application/octet-stream");
+		xml.writeAttribute(kSparkleNamespace, "version", target.version);
+		xml.writeAttribute(kSparkleNamespace, "deltaFrom", result.job.from.version);
+		if (target.operatingSystem.size()) {
+			xml.writeAttribute(kSparkleNamespace, "os", target.operatingSystem);
+		}
+		if (result.signature.success) {
+			QString signatureAttribute = privateKey.algorithm() == QGlitter::DsaSha1 ? "dsaSignature" : "ed25519Signature";
+			xml.writeAttribute(kSparkleNamespace, signatureAttribute, QString::fromLatin1(result.signature.signature.toBase64()));
+			if (treeChunkSize > 0) {
+				xml.writeAttribute(kSparkleNamespace, "treeChunkSize", QString::number(treeChunkSize));
+			}
+		}
+		xml.writeEndElement();
+
+		xml.writeEndElement();
+	}
+
+	output.write("\n");
+
+	return failures ? -3 : 0;
+}
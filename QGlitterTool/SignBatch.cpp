@@ -0,0 +1,152 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "SignBatch.h"
+#include "Common.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#include <iostream>
+
+SignFile::SignFile(const QGlitterPrivateKey &privateKey, qint64 treeChunkSize)
+	: privateKey(privateKey)
+	, treeChunkSize(treeChunkSize)
+{
+}
+
+BatchEntry SignFile::operator()(const QString &path) const
+{
+	BatchEntry entry;
+	entry.path = path;
+	entry.length = QFileInfo(path).size();
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		entry.result.errorMessage = "Unable to read data file " + path;
+	} else if (treeChunkSize > 0) {
+		entry.result = QGlitter::signTree(file, treeChunkSize, privateKey);
+	} else {
+		entry.result = QGlitter::signDevice(file, privateKey);
+	}
+
+	return entry;
+}
+
+void printSignBatchUsage()
+{
+	std::cerr << "    qglitter-tool sign-batch [--tree <chunksize>] [--format tsv|json] [--jobs <count>]" << std::endl;
+	std::cerr << "                             [--passphrase-env <variable>] <keyfile> <file|directory>..." << std::endl;
+}
+
+int signBatch(QStringList arguments)
+{
+	QString value;
+
+	qint64 treeChunkSize = 0;
+	if (takeOption(arguments, "--tree", &value)) {
+		bool ok = false;
+		treeChunkSize = value.toLongLong(&ok);
+		if (!ok || treeChunkSize <= 0) {
+			printSignBatchUsage();
+			return -1;
+		}
+	}
+
+	QString format = "tsv";
+	if (takeOption(arguments, "--format", &value)) {
+		format = value;
+	}
+
+	if (takeOption(arguments, "--jobs", &value)) {
+		bool ok = false;
+		int jobCount = value.toInt(&ok);
+		if (!ok || jobCount <= 0) {
+			printSignBatchUsage();
+			return -1;
+		}
+
+		QThreadPool::globalInstance()->setMaxThreadCount(jobCount);
+	}
+
+	QString passphraseVariable = "";
+	takeOption(arguments, "--passphrase-env", &passphraseVariable);
+
+	if (arguments.size() < 2 || (format != "tsv" && format != "json")) {
+		printSignBatchUsage();
+		return -1;
+	}
+
+	QByteArray keyData;
+	if (!readKeyFile(arguments.takeFirst(), &keyData)) {
+		return -1;
+	}
+
+	// Like the agent, the passphrase is kept off the command line where other users could read it
+	QGlitterPrivateKey privateKey(keyData, readPassphrase(passphraseVariable, keyData));
+	if (!privateKey.isValid()) {
+		std::cerr << "ERROR: " << QGlitter::errorMessage().toStdString() << std::endl;
+		return -1;
+	}
+
+	QStringList files = collectFiles(arguments);
+	QList<BatchEntry> entries = QtConcurrent::blockingMapped<QList<BatchEntry> >(files, SignFile(privateKey, treeChunkSize));
+
+	int failures = 0;
+
+	if (format == "json") {
+		std::cout << "[" << std::endl;
+	} else {
+		std::cout << "path\tlength\tdigest\tsignature" << std::endl;
+	}
+
+	bool first = true;
+	foreach (const BatchEntry &entry, entries) {
+		if (!entry.result.success) {
+			std::cerr << "ERROR: " << entry.path.toStdString() << ": " << entry.result.errorMessage.toStdString() << std::endl;
+			++failures;
+			continue;
+		}
+
+		// Signatures are encoded the same way 'sign' prints them
+		QByteArray digest = entry.result.digest.toHex();
+		QByteArray signature = entry.result.signature.toBase64();
+
+		if (format == "json") {
+			std::cout << (first ? "" : ",\n") << "\t{ \"path\": " << jsonString(entry.path).toStdString()
+				<< ", \"length\": " << entry.length
+				<< ", \"digest\": \"" << digest.data()
+				<< "\", \"signature\": \"" << signature.data() << "\" }";
+		} else {
+			std::cout << entry.path.toStdString() << "\t" << entry.length << "\t" << digest.data() << "\t" << signature.data() << std::endl;
+		}
+
+		first = false;
+	}
+
+	if (format == "json") {
+		std::cout << (first ? "" : "\n") << "]" << std::endl;
+	}
+
+	return failures ? -3 : 0;
+}
@@ -0,0 +1,49 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "QGlitter/Crypto/Crypto.h"
+
+#include <QString>
+#include <QStringList>
+
+struct BatchEntry
+{
+	QString path;
+	qint64 length;
+	QGlitter::CryptoResult result;
+};
+
+// The key is decrypted once and shared by every worker
+struct SignFile
+{
+	typedef BatchEntry result_type;
+
+	SignFile(const QGlitterPrivateKey &privateKey, qint64 treeChunkSize);
+
+	BatchEntry operator()(const QString &path) const;
+
+	QGlitterPrivateKey privateKey;
+	qint64 treeChunkSize;
+};
+
+void printSignBatchUsage();
+int signBatch(QStringList arguments);
@@ -0,0 +1,63 @@
+// Copyright (c) 2012 AlterEgo Studios
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "TeeDevice.h"
+
+TeeDevice::TeeDevice(QIODevice *source, QIODevice *sink)
+	: m_source(source)
+	, m_sink(sink)
+{
+}
+
+bool TeeDevice::atEnd() const
+{
+	return m_source->atEnd();
+}
+
+bool TeeDevice::isSequential() const
+{
+	return true;
+}
+
+qint64 TeeDevice::readData(char *data, qint64 maxSize)
+{
+	qint64 bytesRead = m_source->read(data, maxSize);
+	if (bytesRead <= 0) {
+		return bytesRead;
+	}
+
+	qint64 bytesWritten = 0;
+	while (bytesWritten < bytesRead) {
+		qint64 result = m_sink->write(data + bytesWritten, bytesRead - bytesWritten);
+		if (result <= 0) {
+			setErrorString(m_sink->errorString());
+			return -1;
+		}
+
+		bytesWritten += result;
+	}
+
+	return bytesRead;
+}
+
+qint64 TeeDevice::writeData(const char *, qint64)
+{
+	return -1;
+}
@@ -18,45 +18,120 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include "Agent.h"
+#include "Bench.h"
+#include "Common.h"
+#include "GenerateAppcast.h"
+#include "GenerateDeltas.h"
+#include "SignBatch.h"
+#include "TeeDevice.h"
 #include "QGlitter/Crypto/Crypto.h"
 
 #include <QFile>
+#include <QList>
+#include <QStringList>
 
 #include <iostream>
 
+#ifdef Q_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#endif
+
 void printUsage()
 {
 	std::cerr << "Usage:" << std::endl;
-	std::cerr << "    qglitter-tool generate <keysize> [passphrase]" << std::endl;
-	std::cerr << "    qglitter-tool sign <keyfile> <file> [passphrase]" << std::endl;
-	std::cerr << "    qglitter-tool verify <keyfile> <file> <signature>" << std::endl << std::endl;
+	std::cerr << "    qglitter-tool generate [ed25519] [passphrase]" << std::endl;
+	std::cerr << "    qglitter-tool generate [dsa] <keysize> [passphrase]" << std::endl;
+	std::cerr << "    qglitter-tool sign [--tree <chunksize>] [--tee <destination>] <keyfile> <file|-> [passphrase]" << std::endl;
+	std::cerr << "    qglitter-tool sign [--tree <chunksize>] [--tee <destination>] --agent <socket> <file|->" << std::endl;
+	std::cerr << "    qglitter-tool verify [--tree <chunksize>] [--tee <destination>] <keyfile> <file|-> <signature>" << std::endl;
+	std::cerr << "    qglitter-tool manifest <chunksize> <file>" << std::endl;
+	printSignBatchUsage();
+	printAppcastUsage();
+	printDeltasUsage();
+	printBenchUsage();
+	printAgentUsage();
+	std::cerr << std::endl;
+	std::cerr << "The key type of <keyfile> decides which signature scheme is used." << std::endl;
+	std::cerr << "--tree signs a hash tree of <chunksize> byte chunks, publish it as sparkle:treeChunkSize." << std::endl;
+	std::cerr << "A <file> of - reads the data from stdin, --tee copies it to <destination> while it's hashed." << std::endl;
+	std::cerr << "--agent signs with the key held by a running 'qglitter-tool agent', only the digest is sent to it." << std::endl;
+	std::cerr << "The tree signature covers <chunksize> as well, a tree signature never verifies in flat mode." << std::endl;
+	std::cerr << "manifest lists the chunk digests of that tree, publish it at sparkle:chunkManifest." << std::endl << std::endl;
+}
+
+// The data is hashed here, the agent only ever sees the digest
+static QGlitter::CryptoResult signWithAgent(const QString &socketName, QIODevice &input, qint64 treeChunkSize)
+{
+	QGlitter::CryptoResult result;
+
+	AgentConnection agent;
+	if (!agent.connectToAgent(socketName)) {
+		result.errorMessage = agent.errorString();
+		return result;
+	}
+
+	QGlitter::SignatureAlgorithm algorithm = agent.algorithm();
+	if (algorithm == QGlitter::UnknownSignatureAlgorithm) {
+		result.errorMessage = agent.errorString();
+		return result;
+	}
+
+	result = treeChunkSize > 0 ? QGlitter::treeDigest(input, treeChunkSize) : QGlitter::digestDevice(input, algorithm);
+	if (!result.success) {
+		return result;
+	}
+
+	return agent.sign(result.digest);
 }
 
 int main(int argc, char *argv[])
 {
 	QGlitter::cryptoInit();
 
-	if ((argc == 3 || argc == 4) && QString(argv[1]) == "generate") {
-		bool ok = false;
-		int keySize = QString(argv[2]).toInt(&ok);
-		if (!ok) {
-			printUsage();
-			return -1;
+	if (argc >= 2 && argc <= 5 && QString(argv[1]) == "generate") {
+		QStringList arguments;
+		for (int i = 2; i < argc; ++i) {
+			arguments << argv[i];
+		}
+
+		// A bare key size selects DSA, for compatibility with older scripts
+		QGlitter::SignatureAlgorithm algorithm = QGlitter::Ed25519Sha256;
+		if (!arguments.isEmpty() && QGlitter::signatureAlgorithmFromName(arguments.first()) != QGlitter::UnknownSignatureAlgorithm) {
+			algorithm = QGlitter::signatureAlgorithmFromName(arguments.takeFirst());
+		} else if (!arguments.isEmpty()) {
+			algorithm = QGlitter::DsaSha1;
+		}
+
+		int keySize = 0;
+		if (algorithm == QGlitter::DsaSha1) {
+			bool ok = false;
+			keySize = arguments.isEmpty() ? 0 : arguments.takeFirst().toInt(&ok);
+			if (!ok) {
+				printUsage();
+				return -1;
+			}
+
+			if (keySize < 2048) {
+				std::cerr << "Minimum keysize is 2048" << std::endl;
+				return -1;
+			}
 		}
 
-		if (keySize < 2048) {
-			std::cerr << "Minimum keysize is 2048" << std::endl;
+		if (arguments.size() > 1) {
+			printUsage();
 			return -1;
 		}
 
 		QString passphrase = "";
-		if (argc == 4) {
-			passphrase = argv[3];
+		if (!arguments.isEmpty()) {
+			passphrase = arguments.first();
 		} else {
 			std::cerr << "WARNING: Generating a key without a passphrase" << std::endl;
 		}
 
-		if (!QGlitter::dsaKeygen(keySize, passphrase)) {
+		if (!QGlitter::keygen(algorithm, keySize, passphrase)) {
 			std::cerr << "Unable to generate keypair" << std::endl;
 			if (QGlitter::errorMessage().size()) {
 				std::cerr << "ERROR: " << QGlitter::errorMessage().toStdString() << std::endl;
@@ -67,56 +142,167 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
-	if (argc == 4 || argc == 5) {
-		QString action = argv[1];
-		if (action != "sign" && action != "verify") {
+	QStringList arguments;
+	for (int i = 1; i < argc; ++i) {
+		arguments << argv[i];
+	}
+
+	if (!arguments.isEmpty() && arguments.first() == "sign-batch") {
+		return signBatch(arguments.mid(1));
+	}
+
+	if (!arguments.isEmpty() && arguments.first() == "appcast") {
+		return generateAppcast(arguments.mid(1));
+	}
+
+	if (!arguments.isEmpty() && arguments.first() == "delta") {
+		return generateDeltas(arguments.mid(1));
+	}
+
+	if (!arguments.isEmpty() && arguments.first() == "bench") {
+		return bench(arguments.mid(1));
+	}
+
+	if (!arguments.isEmpty() && arguments.first() == "agent") {
+		return runAgent(arguments.mid(1));
+	}
+
+	QString value;
+
+	qint64 treeChunkSize = 0;
+	if (takeOption(arguments, "--tree", &value)) {
+		bool ok = false;
+		treeChunkSize = value.toLongLong(&ok);
+		if (!ok || treeChunkSize <= 0) {
 			printUsage();
 			return -1;
 		}
+	}
 
-		QFile key(argv[2]);
-		if (!key.open(QIODevice::ReadOnly | QIODevice::Text)) {
-			std::cerr << "Unable to read keyfile: " << argv[2] << std::endl;
+	if (arguments.size() == 3 && arguments.at(0) == "manifest") {
+		bool ok = false;
+		qint64 chunkSize = arguments.at(1).toLongLong(&ok);
+		if (!ok || chunkSize <= 0) {
+			printUsage();
 			return -1;
 		}
 
-		QByteArray keyData = key.readAll();
+		QList<QByteArray> leaves = QGlitter::treeLeafDigests(arguments.at(2), chunkSize);
+		if (leaves.isEmpty()) {
+			std::cerr << "ERROR: " << QGlitter::errorMessage().toStdString() << std::endl;
+			return -1;
+		}
+
+		std::cout << chunkSize << std::endl;
+		foreach (const QByteArray &leaf, leaves) {
+			std::cout << leaf.toHex().data() << std::endl;
+		}
 
-		key.close();
+		return 0;
+	}
 
-		QFile data(argv[3]);
-		if (!data.open(QIODevice::ReadOnly)) {
-			std::cerr << "Unable to read data file " << argv[3] << std::endl;
+	QString teeFileName = "";
+	takeOption(arguments, "--tee", &teeFileName);
+
+	QString agentSocket = "";
+	takeOption(arguments, "--agent", &agentSocket);
+
+	// The agent holds the key, so 'sign --agent' takes no key file
+	bool useAgent = agentSocket.size() > 0;
+	if (useAgent ? arguments.size() == 2 : (arguments.size() == 3 || arguments.size() == 4)) {
+		QString action = arguments.at(0);
+		if ((action != "sign" && action != "verify") || (action == "verify" && (useAgent || arguments.size() != 4))) {
+			printUsage();
 			return -1;
 		}
 
-		if (action == "sign") {
+		QByteArray keyData;
+		if (!useAgent && !readKeyFile(arguments.at(1), &keyData)) {
+			return -1;
+		}
+
+		// "-" reads the data from stdin
+		QString dataFileName = arguments.at(useAgent ? 1 : 2);
+		QFile data;
+		bool opened = false;
+		if (dataFileName == "-") {
+#ifdef Q_OS_WIN
+			_setmode(_fileno(stdin), _O_BINARY);
+#endif
+			opened = data.open(stdin, QIODevice::ReadOnly);
+		} else {
+			data.setFileName(dataFileName);
+			opened = data.open(QIODevice::ReadOnly);
+		}
+
+		if (!opened) {
+			std::cerr << "Unable to read data file " << dataFileName.toStdString() << std::endl;
+			return -1;
+		}
+
+		QFile teeFile(teeFileName);
+		TeeDevice tee(&data, &teeFile);
+		QIODevice *input = &data;
+		if (teeFileName.size()) {
+			if (!teeFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+				std::cerr << "Unable to write " << teeFileName.toStdString() << std::endl;
+				return -1;
+			}
+
+			tee.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+			input = &tee;
+		}
+
+		// Stdin and tees are hashed in one sequential pass, files opened by name in parallel
+		QGlitter::CryptoResult result;
+		if (useAgent) {
+			result = signWithAgent(agentSocket, *input, treeChunkSize);
+		} else if (action == "sign") {
 			QString passphrase = "";
-			if (argc == 5) {
-				passphrase = argv[4];
+			if (arguments.size() == 4) {
+				passphrase = arguments.at(3);
 			}
 
-			std::cout << QGlitter::dsaSign(data, keyData, passphrase).toBase64().data() << std::endl;
-			if (QGlitter::errorMessage().size()) {
-				std::cerr << "ERROR: " << QGlitter::errorMessage().toStdString() << std::endl;
+			QGlitterPrivateKey privateKey(keyData, passphrase);
+
+			if (treeChunkSize > 0) {
+				result = QGlitter::signTree(*input, treeChunkSize, privateKey);
+			} else {
+				result = QGlitter::signDevice(*input, privateKey);
 			}
 		} else {
-			if (argc != 5) {
-				printUsage();
-				return -1;
+			QGlitterPublicKey publicKey(keyData);
+			QByteArray signature = QByteArray::fromBase64(arguments.at(3).toLatin1());
+
+			if (treeChunkSize > 0) {
+				result = QGlitter::verifyTree(*input, treeChunkSize, signature, publicKey);
+			} else {
+				result = QGlitter::verifyDevice(*input, signature, publicKey);
 			}
+		}
 
-			QByteArray signature = QByteArray::fromBase64(argv[4]);
+		if (teeFileName.size() && (!teeFile.flush() || teeFile.error() != QFile::NoError)) {
+			result.success = false;
+			result.errorMessage = "Unable to write " + teeFileName + ": " + teeFile.errorString();
+		}
 
-			if (QGlitter::dsaVerify(data, signature, keyData)) {
-				return 0;
-			} else {
+		// Never leave a copy behind that failed to sign or verify
+		if (teeFileName.size() && !result.success) {
+			teeFile.remove();
+		}
+
+		if (!result.success) {
+			if (action == "verify") {
 				std::cerr << "Signature does not match" << std::endl;
-				if (QGlitter::errorMessage().size()) {
-					std::cerr << "ERROR: " << QGlitter::errorMessage().toStdString() << std::endl;
-				}
-				return -2;
 			}
+			if (result.errorMessage.size()) {
+				std::cerr << "ERROR: " << result.errorMessage.toStdString() << std::endl;
+			}
+			return action == "verify" ? -2 : -3;
+		}
+
+		if (action == "sign") {
+			std::cout << result.signature.toBase64().data() << std::endl;
 		}
 
 		return 0;
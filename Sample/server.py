@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+#
+# Serves the sample feed for trying out the updater by hand.
+#
+#   GET  /appfeed.xml, /2.0.html  the files in this directory
+#   GET  /events                  Server-Sent Events stream for QGlitterUpdater::setPushUrl
+#   POST /announce                sends a "release" event to every connected client
+#
+# A release is also announced whenever appfeed.xml is modified.
+#
+#   python3 server.py [port]
+
+import os
+import sys
+import threading
+import time
+from http.server import SimpleHTTPRequestHandler, ThreadingHTTPServer
+
+KEEPALIVE_INTERVAL = 15
+
+condition = threading.Condition()
+release_id = 0
+
+
+def announce():
+	global release_id
+	with condition:
+		release_id += 1
+		condition.notify_all()
+
+
+def watch_feed(path):
+	last_modified = os.path.getmtime(path)
+	while True:
+		time.sleep(1)
+		modified = os.path.getmtime(path)
+		if modified != last_modified:
+			last_modified = modified
+			announce()
+
+
+class Handler(SimpleHTTPRequestHandler):
+	def do_GET(self):
+		if self.path != '/events':
+			return super().do_GET()
+
+		self.send_response(200)
+		self.send_header('Content-Type', 'text/event-stream')
+		self.send_header('Cache-Control', 'no-cache')
+		self.end_headers()
+
+		# Clients reconnecting with Last-Event-ID get whatever they missed in the meantime
+		try:
+			seen = int(self.headers.get('Last-Event-ID', ''))
+		except ValueError:
+			seen = release_id
+
+		try:
+			while True:
+				with condition:
+					if seen == release_id:
+						condition.wait(KEEPALIVE_INTERVAL)
+					current = release_id
+
+				if current != seen:
+					seen = current
+					self.wfile.write(b'event: release\nid: %d\ndata: appfeed.xml\n\n' % seen)
+				else:
+					self.wfile.write(b': keepalive\n\n')
+				self.wfile.flush()
+		except (BrokenPipeError, ConnectionResetError):
+			pass
+
+	def do_POST(self):
+		if self.path != '/announce':
+			self.send_error(404)
+			return
+
+		announce()
+		self.send_response(204)
+		self.end_headers()
+
+
+if __name__ == '__main__':
+	os.chdir(os.path.dirname(os.path.abspath(__file__)))
+	port = int(sys.argv[1]) if len(sys.argv) > 1 else 8000
+
+	threading.Thread(target=watch_feed, args=('appfeed.xml',), daemon=True).start()
+
+	server = ThreadingHTTPServer(('', port), Handler)
+	server.daemon_threads = True
+	server.serve_forever()
@@ -37,11 +37,13 @@ App::App(QWidget *parent, Qt::WindowFlags f)
 		publicKeyFile.close();
 	}
 
-	QPixmap applicationIcon(":/Resources/TestAppIcon.png");
-	m_updater->setApplicationIcon(&applicationIcon);
-
 	m_updater->setFeedUrl("http://localhost:8000/appfeed.xml");
 
+	QGlitterUpdaterDialogs *updaterDialogs = new QGlitterUpdaterDialogs(m_updater);
+
+	QPixmap applicationIcon(":/Resources/TestAppIcon.png");
+	updaterDialogs->setApplicationIcon(&applicationIcon);
+
 	connect(m_updater, SIGNAL(finishedInstallingUpdate()), qApp, SLOT(quit()));
 }
 